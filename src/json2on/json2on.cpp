@@ -24,55 +24,149 @@ SOFTWARE.
 #include "json2on.h"
 
 
-bool json2on(std::string &jsonString, Config &cfg, std::string &fileName)
+// Construct the geometry object of a geometry record
+static ON_Geometry *constructGeometry(const GeometryRecord &record, Config &cfg)
 {
-    // Copy string to the stream
-    std::stringstream ss(jsonString);
-
-    // Convert string to JSON object
-    Json::Value root;
-    Json::CharReaderBuilder rbuilder;
-    std::string jsonErrors;
-    if (!Json::parseFromStream(rbuilder, ss, &root, &jsonErrors))
+    if (record.type == "mesh")
     {
-        if (!cfg.silent())
-            std::cout << "[ERROR] Failed to parse JSON string: " << jsonErrors << std::endl;
-        return false;
+        ON_Mesh *geom;
+        constructMeshData(record, cfg, geom);
+        return geom;
     }
 
-    // Start modeler
-    initializeRwExt();
+    // Skip the objects without NURBS data (e.g. tessellated surfaces)
+    if (record.controlPointCount() == 0)
+        return nullptr;
+    if (record.parametricDimension == 1)
+    {
+        ON_NurbsCurve *geom;
+        constructNurbsCurveData(record, cfg, geom);
+        return geom;
+    }
+    if (record.parametricDimension == 2)
+    {
+        ON_Brep *geom;
+        constructNurbsSurfaceData(record, cfg, geom);
+        return geom;
+    }
+    return nullptr;
+}
 
-    // Create model
-    ONX_Model model;
+// Rebuild the block definitions and the block instances
+static void constructInstances(const Json::Value &root, Config &cfg, ONX_Model &model)
+{
+    // Definitions may refer to each other, so their ids are created first
+    std::vector<ON_UUID> definitionIds(root["definitions"].size());
+    for (auto &id : definitionIds)
+        ON_CreateUuid(id);
 
-    // Read shape data from JSON
-    for (auto d : root["shape"]["data"])
+    ON_3dmObjectAttributes memberAttributes;
+    memberAttributes.SetMode(ON::object_mode::idef_object);
+    GeometryRecord record;
+    Json::ArrayIndex idx = 0;
+    for (auto &def : root["definitions"])
     {
-        if (root["shape"]["type"].asString() == "curve")
+        // Add the definition geometry as instance definition objects
+        ON_SimpleArray<ON_UUID> memberIds;
+        for (auto &d : def["data"])
         {
-            ON_NurbsCurve *geom;
-            constructNurbsCurveData(d, cfg, geom);
+            GeometryRecordBuilder builder(record);
+            writeJsonValue(d, builder);
+            ON_Geometry *geom = constructGeometry(record, cfg);
             if (geom != nullptr)
-                model.AddManagedModelGeometryComponent(geom, nullptr);
+            {
+                ON_3dmObjectAttributes *attributes = new ON_3dmObjectAttributes(memberAttributes);
+                memberIds.Append(model.AddManagedModelGeometryComponent(geom, attributes).ModelComponentId());
+            }
         }
-        if (root["shape"]["type"].asString() == "surface")
+        for (auto &inst : def["instances"])
         {
-            ON_Brep *geom;
-            constructNurbsSurfaceData(d, cfg, geom);
-            if (geom != nullptr)
-                model.AddManagedModelGeometryComponent(geom, nullptr);
+            ON_InstanceRef *instanceRef;
+            constructInstanceReference(inst, definitionIds, instanceRef);
+            if (instanceRef != nullptr)
+            {
+                ON_3dmObjectAttributes *attributes = new ON_3dmObjectAttributes(memberAttributes);
+                memberIds.Append(model.AddManagedModelGeometryComponent(instanceRef, attributes).ModelComponentId());
+            }
         }
+
+        ON_InstanceDefinition *idef = new ON_InstanceDefinition();
+        idef->SetId(definitionIds[idx]);
+        idef->SetName(ON_wString(def["name"].asCString()));
+        idef->SetInstanceGeometryIdList(memberIds);
+        model.AddManagedModelComponent(idef);
+        idx++;
+    }
+
+    // Add the block instances
+    for (auto &inst : root["instances"])
+    {
+        ON_InstanceRef *instanceRef;
+        constructInstanceReference(inst, definitionIds, instanceRef);
+        if (instanceRef != nullptr)
+            model.AddManagedModelGeometryComponent(instanceRef, nullptr);
+    }
+}
+
+bool json2on(GeometrySource &source, Config &cfg, std::string &fileName)
+{
+    // Start modeler (stopped when leaving the function)
+    RwExtScope rwExt;
+
+    // Create model
+    ONX_Model model;
+
+    // Read shape data one object at a time
+    GeometryRecord record;
+    double deviation = 0.0;
+    while (source.next(record))
+    {
+        ON_Geometry *geom = constructGeometry(record, cfg);
+        if (geom != nullptr)
+            model.AddManagedModelGeometryComponent(geom, nullptr);
+        deviation = std::max(deviation, record.maxDeviation());
+    }
+    if (!source.good())
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Failed to parse geometry data" << std::endl;
+        return false;
     }
 
+    // Read block definitions and instances
+    if (source.blocks().isMember("definitions"))
+        constructInstances(source.blocks(), cfg, model);
+
+    // Report the round-trip deviation of quantized coordinates
+    if (deviation > 0.0 && !cfg.silent())
+        std::cout << "[INFO] Maximum deviation of dequantized control points: " << deviation << std::endl;
+
     // Write model to the file (version = 50)
-    bool saveStatus = model.Write(fileName.c_str(), 50);
+    return model.Write(fileName.c_str(), 50);
+}
+
+bool json2on(std::istream &in, Config &cfg, std::string &fileName)
+{
+    // Convert stream contents to JSON object
+    Json::Value root;
+    Json::CharReaderBuilder rbuilder;
+    std::string jsonErrors;
+    if (!Json::parseFromStream(rbuilder, in, &root, &jsonErrors))
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Failed to parse JSON string: " << jsonErrors << std::endl;
+        return false;
+    }
 
-    // Stop modeler
-    finalizeRwExt();
+    JsonValueSource source(root);
+    return json2on(source, cfg, fileName);
+}
 
-    // Return save status
-    return saveStatus;
+bool json2on(std::string &jsonString, Config &cfg, std::string &fileName)
+{
+    // Copy string to the stream
+    std::stringstream ss(jsonString);
+    return json2on(ss, cfg, fileName);
 }
 
 
@@ -81,27 +175,82 @@ std::string json2on_run(std::string &fileName, Config &cfg)
     // Save file name
     std::string fnameSave;
 
-    // Open JSON file
-    std::ifstream fp(fileName);
-    if (!fp)
+    // Check input format
+    std::string format = cfg.format();
+    if (format != "json" && format != "json_stream" && format != "binary")
     {
         if (!cfg.silent())
-            std::cout << "[ERROR] Cannot open file '" << fileName << "' for reading" << std::endl;
+            std::cout << "[ERROR] Unknown input format '" << format << "'" << std::endl;
+        return fnameSave;
     }
-    else
+
+    // Open the input file; compressed files are detected automatically and decompressed while the objects are read
+    std::ifstream fp(fileName.c_str(), std::ios::in | std::ios::binary);
+    CompressionMethod method = (fp) ? compressionMethodFromStream(fp) : CompressionMethod::none;
+    if (!fp || !compressionAvailable(method))
     {
-        // Read file to a string
-        std::stringstream buffer;
-        buffer << fp.rdbuf();
-        std::string jsonString = buffer.str();
+        if (!cfg.silent())
+        {
+            if (!fp)
+                std::cout << "[ERROR] Cannot open file '" << fileName << "' for reading" << std::endl;
+            else
+                std::cout << "[ERROR] Compression method of file '" << fileName << "' is not supported" << std::endl;
+        }
+        return fnameSave;
+    }
+    std::unique_ptr<CompressedInputBuffer> buffer;
+    std::istream in(nullptr);
+    auto rewind = [&]() {
+        fp.clear();
+        fp.seekg(0);
+        if (method != CompressionMethod::none)
+            buffer.reset(new CompressedInputBuffer(fp.rdbuf()));
+        in.rdbuf((buffer) ? (std::streambuf *)buffer.get() : fp.rdbuf());
+    };
+
+    // Binary input is detected from its magic bytes
+    rewind();
+    std::string magic(8, '\0');
+    in.read(&magic[0], magic.size());
+    magic.resize((std::size_t)in.gcount());
+    bool binaryInput = isBinaryGeometryData(magic);
+    rewind();
 
-        // Prepare save file name
-        fnameSave = fileName.substr(0, fileName.find_last_of(".")) + ".3dm";
+    // Prepare save file name
+    std::string fnameBase = stripCompressionExtension(fileName);
+    fnameSave = fnameBase.substr(0, fnameBase.find_last_of(".")) + ".3dm";
+
+    // Convert geometry to .3dm format
+    bool status;
+    if (format == "binary" && !binaryInput)
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] File '" << fileName << "' is not in binary format" << std::endl;
+        status = false;
+    }
+    else if (binaryInput)
+    {
+        // Read the objects one at a time without building the document tree
+        BinarySource source(in);
+        status = json2on(source, cfg, fnameSave);
+    }
+    else if (format != "json")
+    {
+        JsonStreamSource source(in);
+        status = json2on(source, cfg, fnameSave);
+    }
+    else
+        status = json2on(in, cfg, fnameSave);
 
-        // Convert geometry to .3dm format
-        if (!json2on(jsonString, cfg, fnameSave))
-            fnameSave.clear();
+    // Corrupt or truncated compressed input
+    if (buffer && !buffer->good())
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Cannot decompress file '" << fileName << "'" << std::endl;
+        status = false;
     }
+    if (!status)
+        fnameSave.clear();
 
     return fnameSave;
 }
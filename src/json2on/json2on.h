@@ -26,6 +26,17 @@ SOFTWARE.
 
 #include "common.h"
 #include "rw3dm.h"
+#include "compress.h"
+#include "instances.h"
+#include "geometry_source.h"
+
+/** \brief Convert the objects of a geometry source to a .3dm file.
+*/
+bool json2on(GeometrySource &, Config &, std::string &);
+
+/** \brief Convert geomdl JSON from an input stream to a .3dm file.
+*/
+bool json2on(std::istream &, Config &, std::string &);
 
 /** \brief Convert geomdl JSON string to a .3dm file.
 */
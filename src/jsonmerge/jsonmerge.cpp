@@ -0,0 +1,151 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "jsonmerge.h"
+
+
+// Append the object data of a member of a part file
+static void appendMemberData(const Json::Value &memberDef, Json::Value &dataDef)
+{
+    for (auto &d : memberDef["data"])
+        dataDef.append(d);
+}
+
+// Set a member with its object count and data, if it has any objects
+static void setMemberData(const Json::Value &dataDef, const char *key, Json::Value &root)
+{
+    if (dataDef.empty())
+        return;
+    Json::Value memberDef;
+    memberDef["count"] = dataDef.size();
+    memberDef["data"] = dataDef;
+    root[key] = memberDef;
+}
+
+bool jsonmerge(std::vector<std::string> &fileNames, Config &cfg, std::string &jsonString)
+{
+    // Merged shape data, mesh objects and point clouds
+    Json::Value dataDef(Json::arrayValue);
+    Json::Value meshDataDef(Json::arrayValue);
+    Json::Value pointCloudDataDef(Json::arrayValue);
+    std::string shapeType, emptyShapeType;
+
+    // Append the parts in the given order
+    for (auto &fileName : fileNames)
+    {
+        // Read JSON file (compressed files are detected automatically)
+        std::string partString;
+        CompressionMethod method = CompressionMethod::none;
+        if (!readCompressedFile(fileName, partString, method))
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Cannot read file '" << fileName << "'" << std::endl;
+            return false;
+        }
+
+        // Convert string to JSON object
+        std::stringstream ss(partString);
+        Json::Value root;
+        Json::CharReaderBuilder rbuilder;
+        std::string jsonErrors;
+        if (!Json::parseFromStream(rbuilder, ss, &root, &jsonErrors))
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Failed to parse JSON file '" << fileName << "': " << jsonErrors << std::endl;
+            return false;
+        }
+
+        // All parts should contain the same type of geometry; empty parts (e.g. shards without objects) are not checked
+        const Json::Value &shapeDef = root["shape"];
+        std::string partType = shapeDef["type"].asString();
+        if (emptyShapeType.empty())
+            emptyShapeType = partType;
+        if (!shapeDef["data"].empty())
+        {
+            if (shapeType.empty())
+                shapeType = partType;
+            else if (shapeType != partType)
+            {
+                if (!cfg.silent())
+                    std::cout << "[ERROR] Shape type of file '" << fileName << "' is '" << partType
+                        << "', expected '" << shapeType << "'" << std::endl;
+                return false;
+            }
+        }
+
+        appendMemberData(shapeDef, dataDef);
+        appendMemberData(root["meshes"], meshDataDef);
+        appendMemberData(root["point_clouds"], pointCloudDataDef);
+    }
+
+    // Parts without any objects are merged into an empty document
+    if (shapeType.empty())
+        shapeType = emptyShapeType;
+
+    // Create shape JSON object
+    Json::Value shapeDef;
+    shapeDef["type"] = shapeType;
+    shapeDef["count"] = dataDef.size();
+    shapeDef["data"] = dataDef;
+
+    // Create root JSON object; the mesh objects and point clouds follow the shape data
+    Json::Value root;
+    root["shape"] = shapeDef;
+    setMemberData(meshDataDef, "meshes", root);
+    setMemberData(pointCloudDataDef, "point_clouds", root);
+
+    // Convert root JSON object into a string
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = (cfg.compact()) ? "" : "\t";
+    wbuilder["precision"] = cfg.precision();
+    jsonString = Json::writeString(wbuilder, root);
+
+    if (!cfg.silent())
+        std::cout << "[INFO] Merged " << dataDef.size() + meshDataDef.size() + pointCloudDataDef.size() << " object(s) from " << fileNames.size() << " file(s)" << std::endl;
+
+    return true;
+}
+
+std::string jsonmerge_run(std::vector<std::string> &fileNames, std::string &outputFileName, Config &cfg)
+{
+    // Save file name
+    std::string fnameSave;
+
+    // Merge the part files
+    std::string jsonString;
+    if (jsonmerge(fileNames, cfg, jsonString))
+    {
+        // Compress the output if its extension requires
+        jsonString += "\n";
+        CompressionMethod method = compressionMethodFromFileName(outputFileName);
+        if (!writeCompressedFile(outputFileName, jsonString, method, cfg.threads()))
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Cannot write file '" << outputFileName << "'!" << std::endl;
+        }
+        else
+            fnameSave = outputFileName;
+    }
+
+    return fnameSave;
+}
@@ -0,0 +1,88 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "common.h"
+#include "jsonmerge.h"
+
+
+// JSONMERGE executable
+int main(int argc, char **argv)
+{
+    // Print app information
+    std::cout << "JSONMERGE: Part File Merger for geomdl JSON"
+        << " (RW3DM v" << RW3DM_VERSION_MAJOR << "."
+        << RW3DM_VERSION_MINOR << "."
+        << RW3DM_VERSION_PATCH << ")"
+        << std::endl;
+    std::cout << std::endl;
+
+    // Initialize configuration
+    Config cfg;
+
+    // Options are given as the last argument, if it contains a key-value pair
+    int numFiles = argc - 1;
+    if (argc > 1 && std::string(argv[argc - 1]).find('=') != std::string::npos)
+        numFiles--;
+
+    if (numFiles < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " OUTPUT_FILENAME PART_FILENAME [PART_FILENAME ...] OPTIONS\n" << std::endl;
+        std::cout << "Available options:" << std::endl;
+        for (auto p : cfg.params)
+            std::cout << "  - " << p.first << ": " << p.second.second << std::endl;
+        std::cout << "\nExample: " << argv[0] << " my_file.json my_file.part0of2.json my_file.part1of2.json compact=true" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Output and part file names
+    std::string output = std::string(argv[1]);
+    std::vector<std::string> filenames;
+    for (int i = 2; i <= numFiles; i++)
+        filenames.push_back(std::string(argv[i]));
+
+    // Update configuration
+    if (numFiles < argc - 1)
+        parseConfig(argv[argc - 1], cfg);
+
+    // Print configuration
+    if (cfg.show_config())
+    {
+        std::cout << "Using configuration:" << std::endl;
+        for (auto p : cfg.params)
+            std::cout << "  - " << p.first << ": " << p.second.first << std::endl;
+    }
+
+    // Merge the part files into a single geomdl .json file
+    output = jsonmerge_run(filenames, output, cfg);
+
+    // If merger returns an empty string, it means a failure
+    if (output.empty())
+    {
+        std::cout << "[ERROR] Part files were NOT merged successfully" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Print success message
+    std::cout << "[SUCCESS] Part files were merged to file '" << output << "' successfully" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -67,6 +67,7 @@ int main(int argc, char **argv)
         std::cout << "Using configuration:" << std::endl;
         for (auto p : cfg.params)
             std::cout << "  - " << p.first << ": " << p.second.first << std::endl;
+        std::cout << "Using " << kernelInstructionSet() << " extraction kernels" << std::endl;
     }
 
     // Convert .3dm file to geomdl .json file
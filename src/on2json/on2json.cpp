@@ -22,152 +22,809 @@ SOFTWARE.
 */
 
 #include "on2json.h"
+#include <atomic>
+#include <set>
+#include <limits>
+#include <iomanip>
 
 
-bool on2json(std::string &fileName, Config &cfg, std::string &jsonString)
+// Extract the geometry data using the extraction function of its object type; returns the number of objects written
+static unsigned int extractGeometryData(const ON_Geometry *geometry, Config &cfg, GeometrySink &sink, SurfaceCache *cache)
+{
+    if (ON::curve_object == geometry->ObjectType() && cfg.extract_curves())
+        return extractNurbsCurveData(geometry, cfg, sink);
+
+    switch (geometry->ObjectType())
+    {
+    case ON::surface_object:
+        return extractSurfaceData(geometry, cfg, sink, cache);
+    case ON::brep_object:
+        return extractBrepData(geometry, cfg, sink, cache);
+    case ON::extrusion_object:
+        return extractExtrusionData(geometry, cfg, sink, cache);
+    case ON::mesh_object:
+        return extractMeshData(geometry, cfg, sink);
+    case ON::pointset_object:
+        return extractPointCloudData(geometry, cfg, sink);
+    }
+    return 0;
+}
+
+// Append the extracted data of an object to the data array of its output member
+static void appendGeometryData(const Json::Value &data, GeometrySink &sink, unsigned int &count)
+{
+    for (auto &d : data)
+    {
+        writeJsonValue(d, sink);
+        count++;
+    }
+}
+
+// Member of the document that receives an extracted object
+enum class OutputMember {
+    shape,
+    meshes,
+    pointClouds
+};
+
+// Output member of an object; mesh objects and point clouds are not shapes of the shape type
+static OutputMember outputMember(const ON_Geometry *geometry)
+{
+    switch (geometry->ObjectType())
+    {
+    case ON::mesh_object:
+        return OutputMember::meshes;
+    case ON::pointset_object:
+        return OutputMember::pointClouds;
+    }
+    return OutputMember::shape;
+}
+
+// Destinations of the extracted objects: the shape data is written while the objects are extracted, the mesh objects and point clouds are spooled to temporary files to be written after it
+struct ObjectOutput {
+    ObjectOutput(GeometrySink &sink) : shape(sink) {}
+
+    GeometrySink &sink(OutputMember member)
+    {
+        switch (member)
+        {
+        case OutputMember::meshes:
+            return meshes;
+        case OutputMember::pointClouds:
+            return pointClouds;
+        }
+        return shape;
+    }
+
+    unsigned int &count(OutputMember member)
+    {
+        switch (member)
+        {
+        case OutputMember::meshes:
+            return meshCount;
+        case OutputMember::pointClouds:
+            return pointCloudCount;
+        }
+        return shapeCount;
+    }
+
+    GeometrySink &shape;
+    unsigned int shapeCount = 0;
+    SpoolSink meshes;
+    unsigned int meshCount = 0;
+    SpoolSink pointClouds;
+    unsigned int pointCloudCount = 0;
+};
+
+// Write the spooled objects of a member following the shape data; returns false if they cannot be read back
+static bool writeSpooledObjects(const char *key, SpoolSink &objects, unsigned int count, GeometrySink &sink)
+{
+    sink.beginObject(key);
+    sink.writeInt("count", count);
+    sink.beginArray("data");
+    bool status = objects.replay(sink);
+    sink.endArray();
+    sink.endObject();
+    return status;
+}
+
+// Filters evaluated on the objects before their extraction
+struct ObjectFilters {
+    const double *box = nullptr;
+    AttributeFilter attributes;
+    std::vector<LayerInfo> layers;
+};
+
+// Number of objects rejected while reading
+struct ReadCounters {
+    unsigned int outside = 0;
+    unsigned int filtered = 0;
+    unsigned int failed = 0;
+};
+
+// Check the object attributes against the attribute filters
+static bool matchesObjectAttributes(const ObjectFilters &filters, const ON_3dmObjectAttributes *attributes)
 {
-    // Start modeler
-    initializeRwExt();
+    if (filters.attributes.empty())
+        return true;
+    if (attributes == nullptr)
+        return false;
+    return matchesAttributes(filters.attributes, filters.layers, attributes->m_layer_index, toUtf8Lower(attributes->m_name), attributes->IsVisible());
+}
 
-    // Try to open .3DM file
-    FILE* fp = ON::OpenFile(fileName.c_str(), "rb");
-    if (!fp)
+// Extracted data of a single object
+struct ObjectData {
+    Json::Value data;
+    OutputMember member = OutputMember::shape;
+    unsigned int written = 0;
+    std::string id;
+    bool definitionMember = false;
+    bool reference = false;
+    InstanceReference instance;
+};
+
+// Result of filtering and extracting a single object
+enum class ObjectStatus {
+    extracted,
+    filtered,
+    outside
+};
+
+// Filter and extract a single object; the geometry is written directly to the output if it is given
+static ObjectStatus extractObjectData(const ON_Geometry *geometry, const ON_3dmObjectAttributes *attributes, Config &cfg, const ObjectFilters &filters, SurfaceCache *cache,
+    ObjectData &result, ObjectOutput *output = nullptr)
+{
+    // Block definition geometry is placed by the references, so the filters do not apply
+    if (cfg.instances() && attributes != nullptr && attributes->IsInstanceDefinitionObject())
+    {
+        result.definitionMember = true;
+        result.id = uuidToString(attributes->m_uuid);
+    }
+    else if (!matchesObjectAttributes(filters, attributes))
+        return ObjectStatus::filtered;
+    else if (filters.box != nullptr && !intersectsBoundingBox(geometry, filters.box))
+        return ObjectStatus::outside;
+
+    const ON_InstanceRef *instanceRef = ON_InstanceRef::Cast(geometry);
+    if (instanceRef != nullptr && cfg.instances())
+    {
+        result.reference = true;
+        extractInstanceReference(instanceRef, result.instance);
+    }
+    else if (output != nullptr && !result.definitionMember)
+    {
+        result.member = outputMember(geometry);
+        result.written = extractGeometryData(geometry, cfg, output->sink(result.member), cache);
+    }
+    else
+    {
+        result.member = outputMember(geometry);
+        JsonValueSink sink(result.data, true);
+        extractGeometryData(geometry, cfg, sink, cache);
+    }
+    return ObjectStatus::extracted;
+}
+
+// Append the extracted object to its output member or to the instance table
+static void appendObjectData(const ObjectData &result, ObjectOutput &output, InstanceTable &instanceTable)
+{
+    if (result.definitionMember && result.reference)
+        instanceTable.addMemberReference(result.id, result.instance);
+    else if (result.definitionMember)
+        instanceTable.addMemberGeometry(result.id, result.data);
+    else if (result.reference)
+        instanceTable.addReference(result.instance);
+    else if (result.written > 0)
+        output.count(result.member) += result.written;
+    else
+        appendGeometryData(result.data, output.sink(result.member), output.count(result.member));
+}
+
+// Decode the object records on worker threads and extract their geometry in archive order
+static void extractObjectRecords(const unsigned char *data, const std::vector<ObjectRecord> &records, int archive3dmVersion, unsigned int archiveOpenNURBSVersion,
+    Config &cfg, const ObjectFilters &filters, SurfaceCache *cache, ObjectOutput &output, InstanceTable &instanceTable, ReadCounters &counters)
+{
+    std::vector<ObjectData> results(records.size());
+    std::atomic<unsigned int> outsideCount(0);
+    std::atomic<unsigned int> filteredCount(0);
+    std::atomic<unsigned int> errorCount(0);
+    bool readAttributes = !filters.attributes.empty() || cfg.instances();
+    parallelFor(records.size(), cfg.threads(), [&](std::size_t idx) {
+        ON_Object *object = nullptr;
+        ON_3dmObjectAttributes attributes;
+        if (!readObjectRecord(data, records[idx], archive3dmVersion, archiveOpenNURBSVersion, cfg.fast_read(), object, (readAttributes) ? &attributes : nullptr))
+        {
+            errorCount++;
+            return;
+        }
+        const ON_Geometry *geometry = ON_Geometry::Cast(object);
+        if (geometry != nullptr)
+        {
+            ObjectStatus status = extractObjectData(geometry, (readAttributes) ? &attributes : nullptr, cfg, filters, cache, results[idx]);
+            if (status == ObjectStatus::filtered)
+                filteredCount++;
+            else if (status == ObjectStatus::outside)
+                outsideCount++;
+        }
+        delete object;
+    });
+    counters.outside += outsideCount;
+    counters.filtered += filteredCount;
+    counters.failed += errorCount;
+
+    // Keep the archive order of the objects
+    for (auto &result : results)
+        appendObjectData(result, output, instanceTable);
+}
+
+// Find the range of objects to extract from the objects of the requested types in archive order
+static void objectRange(Config &cfg, std::size_t total, std::size_t &first, std::size_t &last)
+{
+    std::size_t shardIndex, shardCount;
+    if (!cfg.shard().empty() && parseShard(cfg.shard(), shardIndex, shardCount))
+    {
+        // Contiguous shards keep the archive order when the parts are merged
+        first = total * shardIndex / shardCount;
+        last = total * (shardIndex + 1) / shardCount;
+    }
+    else
+    {
+        first = std::min(cfg.start(), total);
+        last = (cfg.count() > 0) ? std::min(first + cfg.count(), total) : total;
+    }
+}
+
+// Select the indexed objects matching the type, range, id, attribute and bounding box filters
+static void selectIndexedRecords(const ObjectIndex &index, unsigned int objectFilter, Config &cfg, const ObjectFilters &filters,
+    std::vector<ObjectRecord> &records, ReadCounters &counters)
+{
+    std::set<std::string> idSet;
+    std::stringstream ss(cfg.ids());
+    std::string item;
+    while (std::getline(ss, item, ','))
+        idSet.insert(item);
+
+    std::vector<const IndexEntry *> typeEntries;
+    for (auto &entry : index.entries)
+    {
+        if (entry.record.type & objectFilter)
+            typeEntries.push_back(&entry);
+    }
+
+    std::size_t first, last;
+    objectRange(cfg, typeEntries.size(), first, last);
+    for (std::size_t idx = first; idx < last; idx++)
+    {
+        const IndexEntry &entry = *typeEntries[idx];
+        if (!idSet.empty() && idSet.find(entry.id) == idSet.end())
+            continue;
+        // Attributes and bounding boxes in the index make it possible to skip objects without decoding them
+        if (!filters.attributes.empty() && !matchesAttributes(filters.attributes, index.layers, entry.layer, entry.name, entry.visible))
+        {
+            counters.filtered++;
+            continue;
+        }
+        const double *filterBox = filters.box;
+        if (filterBox != nullptr && entry.hasBox &&
+            (entry.box[3] < filterBox[0] || entry.box[0] > filterBox[3] ||
+             entry.box[4] < filterBox[1] || entry.box[1] > filterBox[4] ||
+             entry.box[5] < filterBox[2] || entry.box[2] > filterBox[5]))
+        {
+            counters.outside++;
+            continue;
+        }
+        records.push_back(entry.record);
+    }
+}
+
+bool on2json(std::string &fileName, Config &cfg, GeometrySink &sink)
+{
+    // Parse the bounding box filter
+    double filterBox[6];
+    bool useFilterBox = !cfg.bbox().empty();
+    if (useFilterBox && !parseBoundingBox(cfg.bbox(), filterBox))
     {
         if (!cfg.silent())
-            std::cout << "[ERROR] Cannot open file '" << fileName << "' for reading" << std::endl;
+            std::cout << "[ERROR] Invalid bounding box '" << cfg.bbox() << "'" << std::endl;
         return false;
     }
 
-    // Create achive object from file pointer
-    ON_BinaryFile archive(ON::archive_mode::read3dm, fp);
+    // Parse the object type filter
+    unsigned int objectFilter;
+    if (!parseObjectTypes(cfg.types(), cfg.extract_curves(), objectFilter))
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Invalid object types '" << cfg.types() << "'" << std::endl;
+        return false;
+    }
+
+    // Parse the object range
+    std::size_t shardIndex, shardCount;
+    if (!cfg.shard().empty() && !parseShard(cfg.shard(), shardIndex, shardCount))
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Invalid shard '" << cfg.shard() << "'" << std::endl;
+        return false;
+    }
+    bool useRange = !cfg.shard().empty() || cfg.start() > 0 || cfg.count() > 0;
+
+    // Check the tessellation mode
+    std::string tessellate = cfg.tessellate();
+    if (tessellate != "none" && tessellate != "add" && tessellate != "only")
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Invalid tessellation mode '" << tessellate << "'" << std::endl;
+        return false;
+    }
+
+    // Block instances need all definition geometry, so they cannot be combined with partial reads
+    bool useIndex = cfg.index() || !cfg.ids().empty();
+    if (cfg.instances())
+    {
+        if (useIndex || useRange)
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Block instances cannot be combined with index, ids, shard, start or count options" << std::endl;
+            return false;
+        }
+        objectFilter |= ON::instance_reference;
+    }
+
+    // Parse the object attribute filters
+    ObjectFilters filters;
+    filters.box = (useFilterBox) ? filterBox : nullptr;
+    parseAttributeFilter(cfg, filters.attributes);
+
+    // Start modeler (stopped when leaving the function)
+    RwExtScope rwExt;
+
+    // Try to open .3DM file (memory-mapped if possible)
+    MappedFile mappedFile;
+    FILE* fp = nullptr;
+    std::unique_ptr<ON_BinaryArchive> archivePtr;
+    if (cfg.mmap() && mappedFile.open(fileName))
+    {
+        // Create archive object from the mapped file
+        archivePtr.reset(new MappedArchive(mappedFile.data(), mappedFile.size()));
+    }
+    else
+    {
+        fp = ON::OpenFile(fileName.c_str(), "rb");
+        if (!fp)
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Cannot open file '" << fileName << "' for reading" << std::endl;
+            return false;
+        }
+
+        // Create achive object from file pointer
+        archivePtr.reset(new ON_BinaryFile(ON::archive_mode::read3dm, fp));
+    }
+    ON_BinaryArchive &archive = *archivePtr;
+
+    // Object user data is not used by the extraction functions
+    if (cfg.fast_read())
+        archive.SetShouldSerializeUserDataDefault(false);
+
+    // Random access to the object records requires a memory-mapped input file
+    bool useRecords = (cfg.parallel() || useRange) && !useIndex;
+    if ((useIndex || useRecords) && !mappedFile.isOpen())
+    {
+        if (useIndex)
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Indexed access requires a memory-mapped input file" << std::endl;
+            return false;
+        }
+        // Shards depend on the total number of objects, which is only known after scanning the object table
+        if (!cfg.shard().empty())
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Sharding requires a memory-mapped input file" << std::endl;
+            return false;
+        }
+        if (cfg.parallel() && !cfg.silent())
+            std::cout << "[WARNING] Parallel decoding requires a memory-mapped input file, reading sequentially" << std::endl;
+        useRecords = false;
+    }
+
+    // Try to reuse the sidecar index; it is valid as long as the file is not modified and its entries match the object records
+    ObjectIndex index;
+    std::string indexFileName = objectIndexFileName(fileName);
+    bool indexLoaded = false;
+    if (useIndex)
+    {
+        ON__UINT64 fileSize = 0;
+        ON__INT64 fileTime = 0;
+        fileSignature(fileName, fileSize, fileTime);
+        indexLoaded = loadObjectIndex(indexFileName, index) && index.fileSize == fileSize && index.fileTime == fileTime;
+        if (indexLoaded && !validateObjectIndex(index, mappedFile.data(), mappedFile.size()))
+        {
+            if (!cfg.silent())
+                std::cout << "[WARNING] The object index " << indexFileName << " does not match the file, rebuilding it" << std::endl;
+            indexLoaded = false;
+        }
+        index.fileSize = fileSize;
+        index.fileTime = fileTime;
+    }
 
     // Initialize a model archive object
     ONX_Model model;
 
-    // Start reading the model archive
-    unsigned int tableFilter = ON::curve_object | ON::surface_object;
-    if (!model.IncrementalReadBegin(archive, true, tableFilter, (ON_TextLog *)nullptr))
+    // Start reading the model archive (not necessary with a valid index)
+    unsigned int tableFilter = archiveTableFilter(cfg);
+    if (!indexLoaded && !model.IncrementalReadBegin(archive, true, tableFilter, (ON_TextLog *)nullptr))
     {
         if (!cfg.silent())
             std::cout << "[ERROR] Cannot start reading model archive from the file " << fileName << std::endl;
         return false;
     }
 
-    // Create JSON data object
-    Json::Value dataDef;
+    // Layer table is read before the object table
+    if (!indexLoaded)
+        readLayerTable(model, filters.layers);
+
+    // Build the index once by decoding all objects; failures return before anything is written to the sink
+    if (useIndex && !indexLoaded)
+    {
+        index.entries.clear();
+        index.layers = filters.layers;
+        if (!buildObjectIndex(archive, mappedFile.data(), cfg.threads(), cfg.fast_read(), index))
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Cannot build the object index of the file " << fileName << std::endl;
+            return false;
+        }
+        if (!saveObjectIndex(indexFileName, index) && !cfg.silent())
+            std::cout << "[WARNING] Cannot save the object index to the file " << indexFileName << std::endl;
+        else if (!cfg.silent())
+            std::cout << "[INFO] Saved the object index to the file " << indexFileName << std::endl;
+    }
+
+    // Find the byte ranges of the object records without decoding them
+    std::vector<ObjectRecord> scannedRecords;
+    ON__UINT64 skippedBytes = 0;
+    if (useRecords)
+    {
+        if (!archive.BeginRead3dmObjectTable() || !scanObjectTable(archive, objectFilter, scannedRecords, skippedBytes) || !archive.EndRead3dmObjectTable())
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] Cannot scan the object table of the file " << fileName << std::endl;
+            return false;
+        }
+
+        // Keep only the requested range of objects
+        std::size_t first, last;
+        objectRange(cfg, scannedRecords.size(), first, last);
+        scannedRecords = std::vector<ObjectRecord>(scannedRecords.begin() + first, scannedRecords.begin() + last);
+    }
+
+    // Start writing the shape data; the count is written after the data as it is not known in advance
+    sink.beginObject();
+    sink.beginObject("shape");
+    if (cfg.extract_curves())
+        sink.writeString("type", "curve");
+    else
+        sink.writeString("type", (tessellate == "only") ? "mesh" : "surface");
+    sink.beginArray("data");
 
     // Read models
-    unsigned int modelCount = 0;
-    ON_ModelComponentReference mCompRef;
-    while (model.IncrementalReadModelGeometry(archive, true, true, true, 0, mCompRef))
+    ObjectOutput output(sink);
+    InstanceTable instanceTable;
+    SurfaceCache surfaceCache;
+    SurfaceCache *cache = (cfg.surface_cache()) ? &surfaceCache : nullptr;
+    ReadCounters counters;
+
+    if (useIndex)
+    {
+        // Seek straight to the requested objects
+        std::vector<ObjectRecord> records;
+        selectIndexedRecords(index, objectFilter, cfg, filters, records, counters);
+
+        // Attribute filters are already evaluated using the index
+        ObjectFilters decodeFilters;
+        decodeFilters.box = filters.box;
+        extractObjectRecords(mappedFile.data(), records, index.archive3dmVersion, index.archiveOpenNURBSVersion,
+            cfg, decodeFilters, cache, output, instanceTable, counters);
+    }
+    else if (useRecords)
     {
-        // Check if there are any models to read
-        if (!mCompRef.IsEmpty())
+        // Decode and extract the objects on worker threads
+        extractObjectRecords(mappedFile.data(), scannedRecords, archive.Archive3dmVersion(), archive.ArchiveOpenNURBSVersion(),
+            cfg, filters, cache, output, instanceTable, counters);
+    }
+    else
+    {
+        // The total number of objects is not known here, so only start and count apply
+        std::size_t first, last;
+        objectRange(cfg, std::numeric_limits<std::size_t>::max(), first, last);
+        std::size_t objectIdx = 0;
+
+        ON__UINT64 archivePos = archive.CurrentPosition();
+        ON_ModelComponentReference mCompRef;
+        while (model.IncrementalReadModelGeometry(archive, true, true, true, objectFilter, mCompRef))
         {
-            const ON_ModelGeometryComponent &geometryComp = model.ModelGeometryComponentFromId(mCompRef.ModelComponentId());
-            const ON_Geometry *geometry = geometryComp.Geometry((ON_Geometry *)nullptr);
-            if (geometry != nullptr)
+            // Objects rejected by the filter are skipped at the chunk level without decoding
+            ON__UINT64 currentPos = archive.CurrentPosition();
+            if (mCompRef.IsEmpty() && currentPos > archivePos)
+                skippedBytes += currentPos - archivePos;
+            archivePos = currentPos;
+
+            // Check if there are any models to read
+            if (!mCompRef.IsEmpty())
             {
-                Json::Value data;
-                if (ON::curve_object == geometry->ObjectType() && cfg.extract_curves())
+                const ON_ModelGeometryComponent &geometryComp = model.ModelGeometryComponentFromId(mCompRef.ModelComponentId());
+                const ON_Geometry *geometry = geometryComp.Geometry((ON_Geometry *)nullptr);
+                // Skip the objects outside of the requested range
+                bool inRange = (objectIdx >= first && objectIdx < last);
+                objectIdx++;
+                if (!inRange)
+                    geometry = nullptr;
+                if (geometry != nullptr)
                 {
-                    extractNurbsCurveData(geometry, cfg, data);
+                    // Attribute and bounding box filters are evaluated before the conversion
+                    ObjectData result;
+                    ObjectStatus status = extractObjectData(geometry, geometryComp.Attributes(nullptr), cfg, filters, cache, result, &output);
+                    if (status == ObjectStatus::filtered)
+                        counters.filtered++;
+                    else if (status == ObjectStatus::outside)
+                        counters.outside++;
+                    else
+                        appendObjectData(result, output, instanceTable);
                 }
-                else
+
+                // Geometry is not needed after extraction; remove it from the model to free its memory
+                if (cfg.release_geometry())
                 {
-                    switch (geometry->ObjectType())
-                    {
-                    case ON::surface_object:
-                        extractSurfaceData(geometry, cfg, data);
-                        break;
-                    case ON::brep_object:
-                        extractBrepData(geometry, cfg, data);
-                        break;
-                    case ON::extrusion_object:
-                        extractExtrusionData(geometry, cfg, data);
-                        break;
-                    }
-                }
-                // Only add to the array if JSON output is not empty
-                if (!data.empty())
-                {
-                    if (data.isArray())
-                    {
-                        for (auto d : data)
-                        {
-                            dataDef[modelCount] = d;
-                            modelCount++;
-                        }
-                    }
-                    else
-                    {
-                        dataDef[modelCount] = data;
-                        modelCount++;
-                    }
+                    model.RemoveModelComponent(ON_ModelComponent::Type::ModelGeometry, mCompRef.ModelComponentId());
+                    mCompRef = ON_ModelComponentReference();
                 }
             }
         }
     }
 
-    // Finish reading the model archive
-    if (!model.IncrementalReadFinish(archive, true, tableFilter, (ON_TextLog *)nullptr))
+    // Finish reading the model archive; the shape data is still completed, so that the sink stays balanced
+    bool finished = indexLoaded || model.IncrementalReadFinish(archive, true, tableFilter, (ON_TextLog *)nullptr);
+    if (!finished && !cfg.silent())
+        std::cout << "[ERROR] Cannot complete reading model archive from the file " << fileName << std::endl;
+
+    // Write the block definitions and references using the instance definition table; it is read before the object table, so it does not depend on finishing the archive
+    Json::Value definitionsDef(Json::arrayValue), instancesDef(Json::arrayValue);
+    std::size_t instanceCount = 0;
+    if (cfg.instances())
     {
-        if (!cfg.silent())
-            std::cout << "[ERROR] Cannot complete reading model archive from the file " << fileName << std::endl;
-        return false;
+        instanceCount = instanceTable.write(model, definitionsDef, instancesDef);
+        if (instanceCount < instanceTable.referenceCount() && !cfg.silent())
+            std::cout << "[WARNING] Skipped " << instanceTable.referenceCount() - instanceCount << " block instance(s) of linked, empty or missing definitions" << std::endl;
     }
 
     // Close file
-    ON::CloseFile(fp);
+    archivePtr.reset();
+    if (fp)
+        ON::CloseFile(fp);
+    mappedFile.close();
 
-    // Stop modeler
-    finalizeRwExt();
+    // Print filtering statistics
+    if (!cfg.silent())
+    {
+        if (counters.failed > 0)
+            std::cout << "[WARNING] Cannot decode " << counters.failed << " object(s) from the file " << fileName << std::endl;
+        if (cfg.types() != "auto" && skippedBytes > 0)
+            std::cout << "[INFO] Skipped " << skippedBytes << " byte(s) of filtered object types without decoding" << std::endl;
+        if (!filters.attributes.empty())
+            std::cout << "[INFO] Skipped " << counters.filtered << " object(s) by the layer, name or visibility filters" << std::endl;
+        if (useFilterBox)
+            std::cout << "[INFO] Skipped " << counters.outside << " object(s) outside of the bounding box" << std::endl;
+        unsigned int conversions = surfaceCache.hits() + surfaceCache.misses();
+        if (conversions > 0)
+            std::cout << "[INFO] Surface conversion cache: " << surfaceCache.hits() << " hit(s), " << surfaceCache.misses()
+                << " miss(es), " << std::fixed << std::setprecision(1) << 100.0 * surfaceCache.hits() / conversions << std::defaultfloat << "% hit rate" << std::endl;
+    }
 
-    // If no geometry was extracted, do not continue
-    if (dataDef.empty())
-        return false;
+    // Finish writing the shape data
+    sink.endArray();
+    sink.writeInt("count", output.shapeCount);
+    sink.endObject();
+    if (output.meshCount > 0 && !writeSpooledObjects("meshes", output.meshes, output.meshCount, sink))
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Cannot write the mesh objects using a temporary file" << std::endl;
+        finished = false;
+    }
+    if (output.pointCloudCount > 0 && !writeSpooledObjects("point_clouds", output.pointClouds, output.pointCloudCount, sink))
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Cannot write the point clouds using a temporary file" << std::endl;
+        finished = false;
+    }
+    if (cfg.instances())
+    {
+        writeJsonValue(definitionsDef, sink, "definitions");
+        writeJsonValue(instancesDef, sink, "instances");
+    }
+    sink.endObject();
 
-    // Create shape JSON object
-    Json::Value shapeDef;
-    shapeDef["type"] = (cfg.extract_curves()) ? "curve" : "surface";
-    shapeDef["count"] = modelCount;
-    shapeDef["data"] = dataDef;
+    // If no geometry was extracted, do not continue; an empty shard is still a valid part of the merged file
+    bool extracted = output.shapeCount > 0 || output.meshCount > 0 || output.pointCloudCount > 0 || instanceCount > 0;
+    if (finished && !extracted && !cfg.shard().empty() && !cfg.silent())
+        std::cout << "[WARNING] No objects were extracted for the shard " << cfg.shard() << ", writing an empty part" << std::endl;
+    return finished && (extracted || !cfg.shard().empty());
+}
 
-    // Create root JSON object
+// Number of significant digits of the floating-point output values
+static int outputPrecision(Config &cfg)
+{
+    int precision = cfg.precision();
+    // Single precision values do not need more than 9 significant digits
+    if (cfg.coordinates() == "float32" && precision > 9)
+        precision = 9;
+    return precision;
+}
+
+bool on2json(std::string &fileName, Config &cfg, std::string &jsonString)
+{
+    // Build the document in memory
     Json::Value root;
-    root["shape"] = shapeDef;
+    JsonValueSink sink(root);
+    if (!on2json(fileName, cfg, sink))
+        return false;
 
     // Convert root JSON object into a string
     Json::StreamWriterBuilder wbuilder;
-    wbuilder["indentation"] = "\t";
+    wbuilder["indentation"] = (cfg.compact()) ? "" : "\t";
+    wbuilder["precision"] = outputPrecision(cfg);
     jsonString = Json::writeString(wbuilder, root);
 
     return true;
 }
 
+// Write the document to the output file while the objects are extracted
+static bool on2json_stream(std::string &fileName, Config &cfg, const std::string &fnameSave, CompressionMethod method)
+{
+    std::ofstream fileSave(fnameSave.c_str(), std::ios::out | std::ios::binary);
+    if (!fileSave)
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Cannot open file '" << fnameSave << "' for writing!" << std::endl;
+        return false;
+    }
+
+    // Compress the output blocks on worker threads while reading
+    std::unique_ptr<CompressedOutputBuffer> buffer;
+    if (method != CompressionMethod::none)
+        buffer.reset(new CompressedOutputBuffer(fileSave.rdbuf(), method, cfg.threads()));
+    std::ostream out((buffer) ? (std::streambuf *)buffer.get() : fileSave.rdbuf());
+
+    bool status;
+    if (cfg.format() == "binary")
+    {
+        BinarySink sink(out);
+        status = on2json(fileName, cfg, sink);
+    }
+    else if (cfg.format() == "glb")
+    {
+        // The meshes are collected while reading and the file is written at the end
+        GlbSink sink(out, cfg.coordinates() == "quantized");
+        status = on2json(fileName, cfg, sink);
+        if (status && !sink.finish())
+        {
+            if (!cfg.silent())
+                std::cout << "[ERROR] The meshes exceed the 4 GB size limit of the glb format" << std::endl;
+            status = false;
+        }
+        if (status && sink.meshCount() == 0 && !cfg.silent())
+            std::cout << "[WARNING] No meshes were written to the glb file" << std::endl;
+    }
+    else
+    {
+        JsonStreamSink sink(out, outputPrecision(cfg), cfg.compact());
+        status = on2json(fileName, cfg, sink);
+        out << std::endl;
+    }
+
+    if (buffer && !buffer->finish())
+        status = false;
+    fileSave.close();
+    return status && !fileSave.fail();
+}
+
+// Generate a part file name suffix for the extracted object range
+static std::string objectRangeSuffix(Config &cfg)
+{
+    std::stringstream ss;
+    std::size_t shardIndex, shardCount;
+    if (!cfg.shard().empty() && parseShard(cfg.shard(), shardIndex, shardCount))
+    {
+        // Pad the shard index to keep the part files sorted
+        std::size_t width = std::to_string(shardCount).size();
+        ss << ".part" << std::setw(width) << std::setfill('0') << shardIndex << "of" << shardCount;
+    }
+    else if (cfg.start() > 0 || cfg.count() > 0)
+    {
+        ss << ".part" << cfg.start();
+        if (cfg.count() > 0)
+            ss << "-" << cfg.start() + cfg.count();
+    }
+    return ss.str();
+}
+
 std::string on2json_run(std::string &fileName, Config &cfg)
 {
     // Save file name
     std::string fnameSave;
 
+    // Find the compression method
+    CompressionMethod method = CompressionMethod::none;
+    if (!compressionMethodFromName(cfg.compress(), method) || !compressionAvailable(method))
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Compression method '" << cfg.compress() << "' is not supported" << std::endl;
+        return fnameSave;
+    }
+
+    // Check the output format
+    std::string format = cfg.format();
+    if (format != "json" && format != "json_stream" && format != "binary" && format != "glb")
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Output format '" << format << "' is not supported" << std::endl;
+        return fnameSave;
+    }
+
+    // glTF files contain only the meshes
+    if (format == "glb" && cfg.tessellate() == "none")
+    {
+        if (!cfg.silent())
+            std::cout << "[ERROR] Output format 'glb' requires tessellation (tessellate=add or tessellate=only)" << std::endl;
+        return fnameSave;
+    }
+
+    // Stream the extracted geometry data to the file without building the document in memory
+    if (format != "json")
+    {
+        fnameSave = fileName.substr(0, fileName.find_last_of(".")) + objectRangeSuffix(cfg)
+            + ((format == "binary") ? ".rwb" : ((format == "glb") ? ".glb" : ".json")) + compressionExtension(method);
+        if (!on2json_stream(fileName, cfg, fnameSave, method))
+        {
+            // Do not leave an incomplete file behind
+            std::remove(fnameSave.c_str());
+            fnameSave.clear();
+        }
+        return fnameSave;
+    }
+
     // Extract geometry data from .3dm file
     std::string jsonString;
     if (on2json(fileName, cfg, jsonString))
     {
         // Try to open a file for writing JSON string
-        fnameSave = fileName.substr(0, fileName.find_last_of(".")) + ".json";
-        std::ofstream fileSave(fnameSave.c_str(), std::ios::out);
-        if (!fileSave)
+        fnameSave = fileName.substr(0, fileName.find_last_of(".")) + objectRangeSuffix(cfg) + ".json" + compressionExtension(method);
+        if (method == CompressionMethod::none)
         {
-            if (!cfg.silent())
-                std::cout << "[ERROR] Cannot open file '" << fnameSave << "' for writing!" << std::endl;
-            fnameSave.clear();
+            std::ofstream fileSave(fnameSave.c_str(), std::ios::out);
+            if (!fileSave)
+            {
+                if (!cfg.silent())
+                    std::cout << "[ERROR] Cannot open file '" << fnameSave << "' for writing!" << std::endl;
+                fnameSave.clear();
+            }
+            else
+            {
+                // Save JSON string to the file
+                fileSave << jsonString << std::endl;
+                fileSave.close();
+            }
         }
         else
         {
-            // Save JSON string to the file
-            fileSave << jsonString << std::endl;
-            fileSave.close();
+            // Compress JSON string and save it to the file
+            jsonString += "\n";
+            if (!writeCompressedFile(fnameSave, jsonString, method, cfg.threads()))
+            {
+                if (!cfg.silent())
+                    std::cout << "[ERROR] Cannot write compressed file '" << fnameSave << "'!" << std::endl;
+                fnameSave.clear();
+            }
         }
     }
 
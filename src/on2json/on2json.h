@@ -26,6 +26,18 @@ SOFTWARE.
 
 #include "common.h"
 #include "rw3dm.h"
+#include "compress.h"
+#include "mmap_archive.h"
+#include "object_index.h"
+#include "instances.h"
+#include "surface_cache.h"
+#include "geometry_sink.h"
+#include "gltf_sink.h"
+#include <memory>
+
+/** \brief Convert .3dm files to geomdl data written to a sink.
+*/
+bool on2json(std::string &, Config &, GeometrySink &);
 
 /** \brief Convert .3dm files to geomdl JSON string.
 */
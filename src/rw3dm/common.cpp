@@ -22,6 +22,7 @@ SOFTWARE.
 */
 
 #include "common.h"
+#include <atomic>
 
 
 // Parse configuration from a string
@@ -68,3 +69,74 @@ void updateConfig(std::string &key, std::string &value, Config &cfg)
         cfg.params[key].first = val;
     }
 }
+
+// Parse a bounding box string "xmin,ymin,zmin,xmax,ymax,zmax"
+bool parseBoundingBox(const std::string &value, double *box)
+{
+    std::stringstream ss(value);
+    std::string item;
+    int count = 0;
+    while (std::getline(ss, item, ','))
+    {
+        if (count == 6)
+            return false;
+        char *end;
+        box[count] = std::strtod(item.c_str(), &end);
+        if (end == item.c_str())
+            return false;
+        count++;
+    }
+    if (count != 6)
+        return false;
+
+    // Minimum corner should not exceed the maximum corner
+    for (int c = 0; c < 3; c++)
+    {
+        if (box[c] > box[c + 3])
+            return false;
+    }
+    return true;
+}
+
+// Parse a shard definition given as "i/N"
+bool parseShard(const std::string &value, std::size_t &shardIndex, std::size_t &shardCount)
+{
+    std::size_t sep = value.find('/');
+    if (sep == std::string::npos || sep == 0 || sep == value.size() - 1)
+        return false;
+    char *end;
+    std::string indexStr = value.substr(0, sep);
+    std::string countStr = value.substr(sep + 1);
+    shardIndex = std::strtoul(indexStr.c_str(), &end, 10);
+    if (*end != '\0')
+        return false;
+    shardCount = std::strtoul(countStr.c_str(), &end, 10);
+    if (*end != '\0')
+        return false;
+    return shardCount > 0 && shardIndex < shardCount;
+}
+
+// Run a function for each index on a number of worker threads
+void parallelFor(std::size_t count, unsigned int threads, const std::function<void(std::size_t)> &func)
+{
+    std::size_t numThreads = std::min((std::size_t)threads, count);
+    if (numThreads <= 1)
+    {
+        for (std::size_t idx = 0; idx < count; idx++)
+            func(idx);
+        return;
+    }
+
+    // Workers pick the next index from a shared counter
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        for (std::size_t idx = next++; idx < count; idx = next++)
+            func(idx);
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < numThreads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool)
+        t.join();
+}
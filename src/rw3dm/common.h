@@ -31,10 +31,14 @@ SOFTWARE.
 #include <string>
 #include <algorithm>
 #include <map>
+#include <vector>
 #include <exception>
 #include <cstddef>
 #include <cstdio>
+#include <cstdlib>
 #include <cmath>
+#include <thread>
+#include <functional>
 
 // rw3dm configuration
 #include "rw3dmConfig.h"
@@ -49,7 +53,35 @@ struct Config {
         { "normalize", { "1", "Normalize knot vectors and scale trim curves to [0,1] domain" } },
         { "trims", { "1", "Extract trim curves" } },
         { "sense", { "1", "Extract surface and trim curve direction w.r.t. the face" } },
-        { "extract_curves", { "0", "Extract curves (Default is extract surfaces)" } }
+        { "extract_curves", { "0", "Extract curves (Default is extract surfaces)" } },
+        { "compact", { "0", "Write JSON output without indentation and line breaks" } },
+        { "precision", { "17", "Number of significant digits for floating-point values (1-17)" } },
+        { "compress", { "none", "Compress the output file (none, gzip)" } },
+        { "threads", { "0", "Number of worker threads (0: use all available cores)" } },
+        { "compact_layout", { "0", "Write control points as a flat array and omit weights of non-rational geometry" } },
+        { "coordinates", { "float64", "Control point coordinate format (float64, float32, quantized)" } },
+        { "quantize_tolerance", { "1e-6", "Quantization tolerance relative to the object extent" } },
+        { "bbox", { "", "Extract only the geometry intersecting the box xmin,ymin,zmin,xmax,ymax,zmax" } },
+        { "release_geometry", { "1", "Free each geometry object right after its extraction" } },
+        { "types", { "auto", "Comma-separated object types to read (auto, curve, surface, brep, extrusion, mesh, pointcloud)" } },
+        { "fast_read", { "1", "Skip bitmap, texture, material, history and user data tables while reading" } },
+        { "mmap", { "1", "Read the input file through a memory map" } },
+        { "parallel", { "0", "Decode and extract objects on worker threads (requires mmap)" } },
+        { "index", { "0", "Build (once) and use a sidecar index for random access to the objects" } },
+        { "ids", { "", "Comma-separated object UUIDs to extract (uses the sidecar index)" } },
+        { "shard", { "", "Extract only the shard i/N of the objects in archive order (0 <= i < N)" } },
+        { "start", { "0", "Index of the first object to extract in archive order" } },
+        { "count", { "0", "Number of objects to extract starting from 'start' (0: all)" } },
+        { "layers", { "", "Comma-separated layer names of the objects to extract" } },
+        { "names", { "", "Comma-separated names of the objects to extract" } },
+        { "visible_only", { "0", "Extract only the visible objects on visible layers" } },
+        { "instances", { "0", "Extract block definitions once and block instances as references with transforms" } },
+        { "surface_cache", { "0", "Convert identical surfaces to NURBS form only once" } },
+        { "format", { "json", "Data format (json, json_stream, binary, glb)" } },
+        { "tessellate", { "none", "Tessellate surfaces to triangle meshes alongside or instead of the NURBS data (none, add, only)" } },
+        { "chord_tolerance", { "1e-3", "Chord tolerance of the tessellation relative to the surface extent" } },
+        { "render_meshes", { "0", "Use the render meshes cached in the file instead of tessellating BRep faces and extrusions" } },
+        { "point_chunk_size", { "1048576", "Number of points in each packed chunk of the point clouds" } }
     };
 
     // Methods
@@ -71,10 +103,102 @@ struct Config {
     bool extract_curves() {
         return bool(std::atoi(params.at("extract_curves").first.c_str()));
     };
+    bool compact() {
+        return bool(std::atoi(params.at("compact").first.c_str()));
+    };
+    int precision() {
+        int p = std::atoi(params.at("precision").first.c_str());
+        return (p < 1) ? 1 : ((p > 17) ? 17 : p);
+    };
+    bool compact_layout() {
+        return bool(std::atoi(params.at("compact_layout").first.c_str()));
+    };
+    std::string coordinates() {
+        return params.at("coordinates").first;
+    };
+    double quantize_tolerance() {
+        return std::atof(params.at("quantize_tolerance").first.c_str());
+    };
+    bool release_geometry() {
+        return bool(std::atoi(params.at("release_geometry").first.c_str()));
+    };
+    bool index() {
+        return bool(std::atoi(params.at("index").first.c_str()));
+    };
+    std::string ids() {
+        return params.at("ids").first;
+    };
+    std::string shard() {
+        return params.at("shard").first;
+    };
+    std::size_t start() {
+        return std::strtoul(params.at("start").first.c_str(), nullptr, 10);
+    };
+    std::size_t count() {
+        return std::strtoul(params.at("count").first.c_str(), nullptr, 10);
+    };
+    std::string layers() {
+        return params.at("layers").first;
+    };
+    std::string names() {
+        return params.at("names").first;
+    };
+    bool visible_only() {
+        return bool(std::atoi(params.at("visible_only").first.c_str()));
+    };
+    bool instances() {
+        return bool(std::atoi(params.at("instances").first.c_str()));
+    };
+    bool surface_cache() {
+        return bool(std::atoi(params.at("surface_cache").first.c_str()));
+    };
+    std::string format() {
+        return params.at("format").first;
+    };
+    std::string tessellate() {
+        return params.at("tessellate").first;
+    };
+    double chord_tolerance() {
+        return std::atof(params.at("chord_tolerance").first.c_str());
+    };
+    bool render_meshes() {
+        return bool(std::atoi(params.at("render_meshes").first.c_str()));
+    };
+    std::size_t point_chunk_size() {
+        return std::strtoul(params.at("point_chunk_size").first.c_str(), nullptr, 10);
+    };
+    bool parallel() {
+        return bool(std::atoi(params.at("parallel").first.c_str()));
+    };
+    bool mmap() {
+        return bool(std::atoi(params.at("mmap").first.c_str()));
+    };
+    bool fast_read() {
+        return bool(std::atoi(params.at("fast_read").first.c_str()));
+    };
+    std::string types() {
+        return params.at("types").first;
+    };
+    std::string bbox() {
+        return params.at("bbox").first;
+    };
+    std::string compress() {
+        return params.at("compress").first;
+    };
+    unsigned int threads() {
+        int t = std::atoi(params.at("threads").first.c_str());
+        if (t > 0)
+            return (unsigned int)t;
+        unsigned int hc = std::thread::hardware_concurrency();
+        return (hc > 0) ? hc : 1;
+    };
 };
 
 // Function prototypes
 void parseConfig(char *, Config &);
 void updateConfig(std::string &, std::string &, Config &);
+bool parseBoundingBox(const std::string &, double *);
+bool parseShard(const std::string &, std::size_t &, std::size_t &);
+void parallelFor(std::size_t, unsigned int, const std::function<void(std::size_t)> &);
 
 #endif /* COMMON_H */
@@ -0,0 +1,358 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "compress.h"
+#include <opennurbs_public.h>
+#include <opennurbs_zlib.h>
+#include <cstring>
+
+
+// Compress a single block as a complete gzip member
+static std::string gzipBlock(std::string block)
+{
+    std::string out;
+    z_stream strm;
+    std::memset(&strm, 0, sizeof(strm));
+
+    // windowBits = 15 + 16 writes gzip header and trailer instead of zlib wrapper
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return out;
+
+    out.resize(deflateBound(&strm, (uLong)block.size()));
+    strm.next_in = (Bytef *)block.data();
+    strm.avail_in = (uInt)block.size();
+    strm.next_out = (Bytef *)&out[0];
+    strm.avail_out = (uInt)out.size();
+
+    // The output buffer is large enough to finish in one call
+    int status = deflate(&strm, Z_FINISH);
+    out.resize(strm.total_out);
+    deflateEnd(&strm);
+
+    // An empty string indicates a compression failure
+    if (status != Z_STREAM_END)
+        out.clear();
+    return out;
+}
+
+CompressedOutputBuffer::CompressedOutputBuffer(std::streambuf *dest, CompressionMethod method, unsigned int threads, std::size_t blockSize)
+    : m_dest(dest), m_method(method), m_blockSize((blockSize > 0) ? blockSize : 1), m_maxPending((threads > 0) ? threads : 1), m_ok(true), m_finished(false)
+{
+    resetBlock();
+}
+
+CompressedOutputBuffer::~CompressedOutputBuffer()
+{
+    finish();
+}
+
+bool CompressedOutputBuffer::finish()
+{
+    if (!m_finished)
+    {
+        if (pptr() > pbase())
+            submitBlock();
+        drain(0);
+        m_dest->pubsync();
+        m_finished = true;
+
+        // Further output goes through overflow() and fails
+        setp(nullptr, nullptr);
+    }
+    return m_ok;
+}
+
+CompressedOutputBuffer::int_type CompressedOutputBuffer::overflow(int_type ch)
+{
+    if (m_finished)
+        return traits_type::eof();
+
+    // The put area is full
+    if (pptr() == epptr())
+        submitBlock();
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize CompressedOutputBuffer::xsputn(const char *s, std::streamsize count)
+{
+    if (m_finished)
+        return 0;
+
+    // Copy directly into the put area
+    std::streamsize remaining = count;
+    while (remaining > 0)
+    {
+        if (pptr() == epptr())
+            submitBlock();
+        std::streamsize chunk = std::min(remaining, (std::streamsize)(epptr() - pptr()));
+        std::memcpy(pptr(), s, (std::size_t)chunk);
+        pbump((int)chunk);
+        s += chunk;
+        remaining -= chunk;
+    }
+    return count;
+}
+
+int CompressedOutputBuffer::sync()
+{
+    if (m_finished)
+        return m_ok ? 0 : -1;
+
+    // A partial block becomes a gzip member of its own
+    if (pptr() > pbase())
+        submitBlock();
+    drain(0);
+    if (m_dest->pubsync() != 0)
+        m_ok = false;
+    return m_ok ? 0 : -1;
+}
+
+void CompressedOutputBuffer::resetBlock()
+{
+    m_block.resize(m_blockSize);
+    setp(&m_block[0], &m_block[0] + m_blockSize);
+}
+
+void CompressedOutputBuffer::submitBlock()
+{
+    // Keep the number of blocks in flight bounded by the number of threads
+    drain(m_maxPending - 1);
+
+    std::string block;
+    m_block.resize(pptr() - pbase());
+    block.swap(m_block);
+    resetBlock();
+    m_pending.push_back(std::async(std::launch::async, gzipBlock, std::move(block)));
+}
+
+void CompressedOutputBuffer::drain(std::size_t maxPending)
+{
+    // Write the compressed blocks in submission order
+    while (m_pending.size() > maxPending)
+    {
+        std::string out = m_pending.front().get();
+        m_pending.pop_front();
+        if (out.empty())
+            m_ok = false;
+        else if (m_dest->sputn(out.data(), (std::streamsize)out.size()) != (std::streamsize)out.size())
+            m_ok = false;
+    }
+}
+
+
+// Inflate stream of a CompressedInputBuffer
+struct CompressedInputBuffer::InflateState {
+    z_stream strm;
+};
+
+CompressedInputBuffer::CompressedInputBuffer(std::streambuf *source, std::size_t blockSize)
+    : m_source(source), m_state(new InflateState), m_input((blockSize > 0) ? blockSize : 1, '\0'), m_output(m_input.size(), '\0'),
+    m_ok(true), m_memberEnd(false), m_sourceEnd(false)
+{
+    // windowBits = 15 + 32 enables automatic gzip/zlib header detection
+    std::memset(&m_state->strm, 0, sizeof(m_state->strm));
+    if (inflateInit2(&m_state->strm, 15 + 32) != Z_OK)
+        m_ok = false;
+}
+
+CompressedInputBuffer::~CompressedInputBuffer()
+{
+    inflateEnd(&m_state->strm);
+}
+
+bool CompressedInputBuffer::good() const
+{
+    return m_ok;
+}
+
+CompressedInputBuffer::int_type CompressedInputBuffer::underflow()
+{
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    z_stream &strm = m_state->strm;
+    while (m_ok)
+    {
+        // Refill the input buffer once inflate has consumed it
+        if (strm.avail_in == 0 && !m_sourceEnd)
+        {
+            std::streamsize count = m_source->sgetn(&m_input[0], (std::streamsize)m_input.size());
+            if (count > 0)
+            {
+                strm.next_in = (Bytef *)&m_input[0];
+                strm.avail_in = (uInt)count;
+            }
+            else
+                m_sourceEnd = true;
+        }
+
+        // A new gzip member starts after the end of the previous one
+        if (m_memberEnd)
+        {
+            if (strm.avail_in == 0)
+                break;
+            if (inflateReset(&strm) != Z_OK)
+                m_ok = false;
+            m_memberEnd = false;
+        }
+
+        strm.next_out = (Bytef *)&m_output[0];
+        strm.avail_out = (uInt)m_output.size();
+        uInt availIn = strm.avail_in;
+        int ret = inflate(&strm, Z_NO_FLUSH);
+        std::size_t count = m_output.size() - strm.avail_out;
+        if (ret == Z_STREAM_END)
+            m_memberEnd = true;
+        else if (ret == Z_BUF_ERROR)
+        {
+            // No progress without more input (e.g. after an exactly filled output block); truncated input does not reach the end of the last member
+            if (count == 0 && (m_sourceEnd || (availIn > 0 && strm.avail_in == availIn)))
+                m_ok = false;
+        }
+        else if (ret != Z_OK)
+            m_ok = false;
+
+        if (count > 0)
+        {
+            setg(&m_output[0], &m_output[0], &m_output[0] + count);
+            return traits_type::to_int_type(*gptr());
+        }
+    }
+    return traits_type::eof();
+}
+
+
+bool compressionMethodFromName(const std::string &name, CompressionMethod &method)
+{
+    if (name.empty() || name == "none" || name == "0")
+        method = CompressionMethod::none;
+    else if (name == "gzip" || name == "gz" || name == "1")
+        method = CompressionMethod::gzip;
+    else if (name == "zstd" || name == "zst")
+        method = CompressionMethod::zstd;
+    else
+        return false;
+    return true;
+}
+
+CompressionMethod compressionMethodFromFileName(const std::string &fileName)
+{
+    std::string ext = fileName.substr(fileName.find_last_of(".") + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == "gz")
+        return CompressionMethod::gzip;
+    if (ext == "zst")
+        return CompressionMethod::zstd;
+    return CompressionMethod::none;
+}
+
+CompressionMethod compressionMethodFromStream(std::istream &in)
+{
+    // Detect the compression method from the magic bytes and rewind the stream
+    unsigned char magic[4] = { 0, 0, 0, 0 };
+    in.read((char *)magic, 4);
+    std::streamsize magicSize = in.gcount();
+    in.clear();
+    in.seekg(0);
+    if (magicSize >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+        return CompressionMethod::gzip;
+    if (magicSize == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD)
+        return CompressionMethod::zstd;
+    return CompressionMethod::none;
+}
+
+bool compressionAvailable(CompressionMethod method)
+{
+    // zstd sources are not bundled with the 3rd party libraries
+    return method != CompressionMethod::zstd;
+}
+
+std::string compressionExtension(CompressionMethod method)
+{
+    switch (method)
+    {
+    case CompressionMethod::gzip:
+        return ".gz";
+    case CompressionMethod::zstd:
+        return ".zst";
+    default:
+        return "";
+    }
+}
+
+std::string stripCompressionExtension(const std::string &fileName)
+{
+    if (compressionMethodFromFileName(fileName) == CompressionMethod::none)
+        return fileName;
+    return fileName.substr(0, fileName.find_last_of("."));
+}
+
+bool writeCompressedFile(const std::string &fileName, const std::string &data, CompressionMethod method, unsigned int threads)
+{
+    if (!compressionAvailable(method))
+        return false;
+
+    std::ofstream fp(fileName.c_str(), std::ios::out | std::ios::binary);
+    if (!fp)
+        return false;
+
+    if (method == CompressionMethod::none)
+    {
+        fp << data;
+        return fp.good();
+    }
+
+    CompressedOutputBuffer buffer(fp.rdbuf(), method, threads);
+    std::ostream out(&buffer);
+    out << data;
+    return buffer.finish() && fp.good();
+}
+
+bool readCompressedFile(const std::string &fileName, std::string &data, CompressionMethod &method)
+{
+    method = CompressionMethod::none;
+    std::ifstream fp(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!fp)
+        return false;
+
+    method = compressionMethodFromStream(fp);
+    if (!compressionAvailable(method))
+        return false;
+
+    if (method == CompressionMethod::gzip)
+    {
+        CompressedInputBuffer buffer(fp.rdbuf());
+        data.assign(std::istreambuf_iterator<char>(&buffer), std::istreambuf_iterator<char>());
+        return buffer.good();
+    }
+
+    std::stringstream buffer;
+    buffer << fp.rdbuf();
+    data = buffer.str();
+    return true;
+}
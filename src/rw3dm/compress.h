@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "common.h"
+#include <deque>
+#include <future>
+#include <memory>
+
+#ifndef RW3DM_COMPRESS_BLOCK_SIZE
+#define RW3DM_COMPRESS_BLOCK_SIZE (1 << 20)
+#endif
+
+// Supported compression methods
+enum class CompressionMethod {
+    none,
+    gzip,
+    zstd
+};
+
+/** \brief Stream buffer that compresses its input in blocks using worker threads.
+
+Each block is compressed independently as a separate gzip member, so the
+concatenated output is a valid gzip file. Blocks are written to the
+destination in order while the caller keeps producing data.
+*/
+class CompressedOutputBuffer : public std::streambuf
+{
+public:
+    CompressedOutputBuffer(std::streambuf *, CompressionMethod, unsigned int, std::size_t = RW3DM_COMPRESS_BLOCK_SIZE);
+    ~CompressedOutputBuffer();
+
+    // Compresses the remaining data and writes everything to the destination
+    bool finish();
+
+protected:
+    int_type overflow(int_type) override;
+    std::streamsize xsputn(const char *, std::streamsize) override;
+    int sync() override;
+
+private:
+    void resetBlock();
+    void submitBlock();
+    void drain(std::size_t);
+
+    std::streambuf *m_dest;
+    CompressionMethod m_method;
+    std::size_t m_blockSize;
+    std::size_t m_maxPending;
+    std::string m_block; // Put area of one uncompressed block
+    std::deque< std::future<std::string> > m_pending;
+    bool m_ok;
+    bool m_finished;
+};
+
+/** \brief Stream buffer that decompresses its source while it is read.
+
+Concatenated gzip members (e.g. the blocks of CompressedOutputBuffer) are read
+as a single stream, holding only one block of compressed and decompressed
+data at a time.
+*/
+class CompressedInputBuffer : public std::streambuf
+{
+public:
+    CompressedInputBuffer(std::streambuf *, std::size_t = RW3DM_COMPRESS_BLOCK_SIZE);
+    ~CompressedInputBuffer();
+
+    // Returns false if the source is corrupt or ends inside a gzip member
+    bool good() const;
+
+protected:
+    int_type underflow() override;
+
+private:
+    CompressedInputBuffer(const CompressedInputBuffer &) = delete;
+    CompressedInputBuffer &operator=(const CompressedInputBuffer &) = delete;
+
+    struct InflateState;
+
+    std::streambuf *m_source;
+    std::unique_ptr<InflateState> m_state;
+    std::string m_input;
+    std::string m_output; // Get area of one decompressed block
+    bool m_ok;
+    bool m_memberEnd;
+    bool m_sourceEnd;
+};
+
+// Compression method helpers
+bool compressionMethodFromName(const std::string &, CompressionMethod &);
+CompressionMethod compressionMethodFromFileName(const std::string &);
+CompressionMethod compressionMethodFromStream(std::istream &);
+bool compressionAvailable(CompressionMethod);
+std::string compressionExtension(CompressionMethod);
+std::string stripCompressionExtension(const std::string &);
+
+// File I/O with transparent compression
+bool writeCompressedFile(const std::string &, const std::string &, CompressionMethod, unsigned int);
+bool readCompressedFile(const std::string &, std::string &, CompressionMethod &);
+
+#endif /* COMPRESS_H */
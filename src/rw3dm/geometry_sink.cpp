@@ -0,0 +1,681 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geometry_sink.h"
+#include "geometry_source.h"
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+
+void GeometrySink::writeDoubleArray(const char *key, const double *values, std::size_t count)
+{
+    beginArray(key);
+    for (std::size_t idx = 0; idx < count; idx++)
+        writeDouble(nullptr, values[idx]);
+    endArray();
+}
+
+void GeometrySink::writeFloatArray(const char *key, const float *values, std::size_t count)
+{
+    std::vector<double> converted(values, values + count);
+    writeDoubleArray(key, converted.data(), count);
+}
+
+void GeometrySink::writeIntArray(const char *key, const Json::Int64 *values, std::size_t count)
+{
+    beginArray(key);
+    for (std::size_t idx = 0; idx < count; idx++)
+        writeInt(nullptr, values[idx]);
+    endArray();
+}
+
+void GeometrySink::writeBytes(const char *key, const unsigned char *data, std::size_t size)
+{
+    writeString(key, encodeBase64(data, size));
+}
+
+
+JsonValueSink::JsonValueSink(Json::Value &target, bool topLevelArray) : m_target(target), m_topLevelArray(topLevelArray)
+{
+    if (m_topLevelArray && !m_target.isArray())
+        m_target = Json::Value(Json::arrayValue);
+}
+
+Json::Value &JsonValueSink::slot(const char *key)
+{
+    if (m_stack.empty())
+        return (m_topLevelArray) ? m_target.append(Json::Value()) : m_target;
+    Json::Value &parent = *m_stack.back();
+    if (parent.isArray())
+        return parent.append(Json::Value());
+    return parent[key];
+}
+
+void JsonValueSink::beginObject(const char *key)
+{
+    Json::Value &value = slot(key);
+    value = Json::Value(Json::objectValue);
+    m_stack.push_back(&value);
+}
+
+void JsonValueSink::endObject()
+{
+    m_stack.pop_back();
+}
+
+void JsonValueSink::beginArray(const char *key)
+{
+    Json::Value &value = slot(key);
+    value = Json::Value(Json::arrayValue);
+    m_stack.push_back(&value);
+}
+
+void JsonValueSink::endArray()
+{
+    m_stack.pop_back();
+}
+
+void JsonValueSink::writeBool(const char *key, bool value)
+{
+    slot(key) = value;
+}
+
+void JsonValueSink::writeInt(const char *key, Json::Int64 value)
+{
+    slot(key) = value;
+}
+
+void JsonValueSink::writeDouble(const char *key, double value)
+{
+    slot(key) = value;
+}
+
+void JsonValueSink::writeString(const char *key, const std::string &value)
+{
+    slot(key) = value;
+}
+
+void JsonValueSink::writeDoubleArray(const char *key, const double *values, std::size_t count)
+{
+    Json::Value &value = slot(key);
+    value = Json::Value(Json::arrayValue);
+    value.resize((Json::ArrayIndex)count);
+    for (std::size_t idx = 0; idx < count; idx++)
+        value[(Json::ArrayIndex)idx] = values[idx];
+}
+
+void JsonValueSink::writeIntArray(const char *key, const Json::Int64 *values, std::size_t count)
+{
+    Json::Value &value = slot(key);
+    value = Json::Value(Json::arrayValue);
+    value.resize((Json::ArrayIndex)count);
+    for (std::size_t idx = 0; idx < count; idx++)
+        value[(Json::ArrayIndex)idx] = values[idx];
+}
+
+
+JsonStreamSink::JsonStreamSink(std::ostream &out, int precision, bool compact) : m_out(out), m_precision(precision), m_compact(compact)
+{
+}
+
+void JsonStreamSink::newLine()
+{
+    if (m_compact)
+        return;
+    m_out << '\n';
+    for (std::size_t level = 0; level < m_first.size(); level++)
+        m_out << '\t';
+}
+
+void JsonStreamSink::beginValue(const char *key)
+{
+    // Top-level values do not have a container
+    if (m_first.empty())
+        return;
+    if (!m_first.back())
+        m_out << ',';
+    m_first.back() = false;
+    newLine();
+    if (key != nullptr)
+    {
+        writeQuoted(key);
+        m_out << ((m_compact) ? ":" : " : ");
+    }
+}
+
+void JsonStreamSink::writeNumber(double value)
+{
+    if (!std::isfinite(value))
+    {
+        m_out << "null";
+        return;
+    }
+
+    // Same format as jsoncpp: shortest form with the requested precision, always with a decimal point
+    char buffer[40];
+    std::snprintf(buffer, sizeof(buffer), "%.*g", m_precision, value);
+    m_out << buffer;
+    if (std::strpbrk(buffer, ".e") == nullptr)
+        m_out << ".0";
+}
+
+void JsonStreamSink::writeQuoted(const std::string &value)
+{
+    m_out << '"';
+    for (char ch : value)
+    {
+        switch (ch)
+        {
+        case '"': m_out << "\\\""; break;
+        case '\\': m_out << "\\\\"; break;
+        case '\n': m_out << "\\n"; break;
+        case '\r': m_out << "\\r"; break;
+        case '\t': m_out << "\\t"; break;
+        default:
+            if ((unsigned char)ch < 0x20)
+            {
+                char buffer[8];
+                std::snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned char)ch);
+                m_out << buffer;
+            }
+            else
+                m_out << ch;
+        }
+    }
+    m_out << '"';
+}
+
+void JsonStreamSink::beginObject(const char *key)
+{
+    beginValue(key);
+    m_out << '{';
+    m_first.push_back(true);
+}
+
+void JsonStreamSink::endObject()
+{
+    bool empty = m_first.back();
+    m_first.pop_back();
+    if (!empty)
+        newLine();
+    m_out << '}';
+}
+
+void JsonStreamSink::beginArray(const char *key)
+{
+    beginValue(key);
+    m_out << '[';
+    m_first.push_back(true);
+}
+
+void JsonStreamSink::endArray()
+{
+    bool empty = m_first.back();
+    m_first.pop_back();
+    if (!empty)
+        newLine();
+    m_out << ']';
+}
+
+void JsonStreamSink::writeBool(const char *key, bool value)
+{
+    beginValue(key);
+    m_out << ((value) ? "true" : "false");
+}
+
+void JsonStreamSink::writeInt(const char *key, Json::Int64 value)
+{
+    beginValue(key);
+    m_out << value;
+}
+
+void JsonStreamSink::writeDouble(const char *key, double value)
+{
+    beginValue(key);
+    writeNumber(value);
+}
+
+void JsonStreamSink::writeString(const char *key, const std::string &value)
+{
+    beginValue(key);
+    writeQuoted(value);
+}
+
+void JsonStreamSink::writeDoubleArray(const char *key, const double *values, std::size_t count)
+{
+    // Numeric arrays are written on a single line
+    beginValue(key);
+    m_out << '[';
+    for (std::size_t idx = 0; idx < count; idx++)
+    {
+        if (idx > 0)
+            m_out << ((m_compact) ? "," : ", ");
+        writeNumber(values[idx]);
+    }
+    m_out << ']';
+}
+
+void JsonStreamSink::writeIntArray(const char *key, const Json::Int64 *values, std::size_t count)
+{
+    beginValue(key);
+    m_out << '[';
+    for (std::size_t idx = 0; idx < count; idx++)
+    {
+        if (idx > 0)
+            m_out << ((m_compact) ? "," : ", ");
+        m_out << values[idx];
+    }
+    m_out << ']';
+}
+
+void JsonStreamSink::writeBytes(const char *key, const unsigned char *data, std::size_t size)
+{
+    // Base64 strings do not need escaping
+    beginValue(key);
+    std::string encoded = encodeBase64(data, size);
+    m_out << '"';
+    m_out.write(encoded.data(), encoded.size());
+    m_out << '"';
+}
+
+
+BinarySink::BinarySink(std::ostream &out) : m_out(out)
+{
+    m_out.write("RW3DMBIN", 8);
+    writeUInt(RW3DM_BINARY_VERSION, 4);
+}
+
+void BinarySink::writeUInt(std::uint64_t value, int numBytes)
+{
+    // Little-endian regardless of the host byte order
+    char buffer[8];
+    for (int b = 0; b < numBytes; b++)
+        buffer[b] = (char)((value >> (8 * b)) & 0xFF);
+    m_out.write(buffer, numBytes);
+}
+
+void BinarySink::beginValue(char tag, const char *key)
+{
+    m_out.put(tag);
+    if (!m_inObject.empty() && m_inObject.back())
+    {
+        std::size_t length = (key != nullptr) ? std::strlen(key) : 0;
+        writeUInt(length, 2);
+        m_out.write(key, length);
+    }
+}
+
+void BinarySink::beginObject(const char *key)
+{
+    beginValue(BinaryTag::beginObject, key);
+    m_inObject.push_back(true);
+}
+
+void BinarySink::endObject()
+{
+    m_inObject.pop_back();
+    m_out.put(BinaryTag::endObject);
+}
+
+void BinarySink::beginArray(const char *key)
+{
+    beginValue(BinaryTag::beginArray, key);
+    m_inObject.push_back(false);
+}
+
+void BinarySink::endArray()
+{
+    m_inObject.pop_back();
+    m_out.put(BinaryTag::endArray);
+}
+
+void BinarySink::writeBool(const char *key, bool value)
+{
+    beginValue((value) ? BinaryTag::boolTrue : BinaryTag::boolFalse, key);
+}
+
+void BinarySink::writeInt(const char *key, Json::Int64 value)
+{
+    beginValue(BinaryTag::int64, key);
+    writeUInt((std::uint64_t)value, 8);
+}
+
+void BinarySink::writeDouble(const char *key, double value)
+{
+    beginValue(BinaryTag::float64, key);
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeUInt(bits, 8);
+}
+
+void BinarySink::writeString(const char *key, const std::string &value)
+{
+    beginValue(BinaryTag::string, key);
+    writeUInt(value.size(), 4);
+    m_out.write(value.data(), value.size());
+}
+
+void BinarySink::writeDoubleArray(const char *key, const double *values, std::size_t count)
+{
+    beginValue(BinaryTag::float64Array, key);
+    writeUInt(count, 8);
+    for (std::size_t idx = 0; idx < count; idx++)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &values[idx], sizeof(bits));
+        writeUInt(bits, 8);
+    }
+}
+
+void BinarySink::writeFloatArray(const char *key, const float *values, std::size_t count)
+{
+    beginValue(BinaryTag::float32Array, key);
+    writeUInt(count, 8);
+    for (std::size_t idx = 0; idx < count; idx++)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &values[idx], sizeof(bits));
+        writeUInt(bits, 4);
+    }
+}
+
+void BinarySink::writeIntArray(const char *key, const Json::Int64 *values, std::size_t count)
+{
+    beginValue(BinaryTag::int64Array, key);
+    writeUInt(count, 8);
+    for (std::size_t idx = 0; idx < count; idx++)
+        writeUInt((std::uint64_t)values[idx], 8);
+}
+
+void BinarySink::writeBytes(const char *key, const unsigned char *data, std::size_t size)
+{
+    beginValue(BinaryTag::bytes, key);
+    writeUInt(size, 8);
+    m_out.write((const char *)data, size);
+}
+
+
+SpoolSink::SpoolSink()
+{
+}
+
+SpoolSink::~SpoolSink()
+{
+    m_sink.reset();
+    if (m_file.is_open())
+    {
+        m_file.close();
+        std::error_code error;
+        std::filesystem::remove(m_fileName, error);
+    }
+}
+
+GeometrySink &SpoolSink::spool()
+{
+    if (!m_sink)
+    {
+        // Random names do not collide with the spool files of other processes
+        std::error_code error;
+        std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+        std::random_device random;
+        for (int attempt = 0; attempt < 16 && !m_file.is_open(); attempt++)
+        {
+            std::stringstream ss;
+            ss << "rw3dm-" << std::hex << random() << random() << ".spool";
+            std::filesystem::path path = directory / ss.str();
+            if (std::filesystem::exists(path, error))
+                continue;
+            m_fileName = path.string();
+            m_file.open(m_fileName.c_str(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+        }
+        m_sink.reset(new BinarySink(m_file));
+    }
+    return *m_sink;
+}
+
+void SpoolSink::beginObject(const char *key)
+{
+    spool().beginObject(key);
+}
+
+void SpoolSink::endObject()
+{
+    spool().endObject();
+}
+
+void SpoolSink::beginArray(const char *key)
+{
+    spool().beginArray(key);
+}
+
+void SpoolSink::endArray()
+{
+    spool().endArray();
+}
+
+void SpoolSink::writeBool(const char *key, bool value)
+{
+    spool().writeBool(key, value);
+}
+
+void SpoolSink::writeInt(const char *key, Json::Int64 value)
+{
+    spool().writeInt(key, value);
+}
+
+void SpoolSink::writeDouble(const char *key, double value)
+{
+    spool().writeDouble(key, value);
+}
+
+void SpoolSink::writeString(const char *key, const std::string &value)
+{
+    spool().writeString(key, value);
+}
+
+void SpoolSink::writeDoubleArray(const char *key, const double *values, std::size_t count)
+{
+    spool().writeDoubleArray(key, values, count);
+}
+
+void SpoolSink::writeFloatArray(const char *key, const float *values, std::size_t count)
+{
+    spool().writeFloatArray(key, values, count);
+}
+
+void SpoolSink::writeIntArray(const char *key, const Json::Int64 *values, std::size_t count)
+{
+    spool().writeIntArray(key, values, count);
+}
+
+void SpoolSink::writeBytes(const char *key, const unsigned char *data, std::size_t size)
+{
+    spool().writeBytes(key, data, size);
+}
+
+bool SpoolSink::good() const
+{
+    return !m_sink || (m_file.is_open() && m_file.good());
+}
+
+bool SpoolSink::replay(GeometrySink &sink)
+{
+    if (!m_sink)
+        return true;
+    if (!good() || !m_file.flush())
+        return false;
+
+    // The events are read back one value at a time
+    m_file.seekg(0);
+    BinarySource source(m_file);
+    return source.readValues(sink);
+}
+
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string encodeBase64(const unsigned char *data, std::size_t size)
+{
+    std::string result;
+    result.reserve(4 * ((size + 2) / 3));
+    std::size_t idx = 0;
+    for (; idx + 2 < size; idx += 3)
+    {
+        std::uint32_t triple = (data[idx] << 16) | (data[idx + 1] << 8) | data[idx + 2];
+        result.push_back(base64Alphabet[(triple >> 18) & 0x3F]);
+        result.push_back(base64Alphabet[(triple >> 12) & 0x3F]);
+        result.push_back(base64Alphabet[(triple >> 6) & 0x3F]);
+        result.push_back(base64Alphabet[triple & 0x3F]);
+    }
+
+    // Pad the last group
+    if (idx < size)
+    {
+        std::uint32_t triple = data[idx] << 16;
+        if (idx + 1 < size)
+            triple |= data[idx + 1] << 8;
+        result.push_back(base64Alphabet[(triple >> 18) & 0x3F]);
+        result.push_back(base64Alphabet[(triple >> 12) & 0x3F]);
+        result.push_back((idx + 1 < size) ? base64Alphabet[(triple >> 6) & 0x3F] : '=');
+        result.push_back('=');
+    }
+    return result;
+}
+
+static int base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+bool decodeBase64(const std::string &value, std::vector<unsigned char> &data)
+{
+    data.clear();
+    if (value.size() % 4 != 0)
+        return false;
+    data.reserve(3 * (value.size() / 4));
+    for (std::size_t idx = 0; idx < value.size(); idx += 4)
+    {
+        // Padding is only allowed in the last group
+        int padding = 0;
+        std::uint32_t quad = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            char c = value[idx + k];
+            if (c == '=' && idx + 4 == value.size() && k >= 2)
+            {
+                padding++;
+                quad <<= 6;
+                continue;
+            }
+            int v = base64Value(c);
+            if (v < 0 || padding > 0)
+                return false;
+            quad = (quad << 6) | (std::uint32_t)v;
+        }
+        data.push_back((unsigned char)((quad >> 16) & 0xFF));
+        if (padding < 2)
+            data.push_back((unsigned char)((quad >> 8) & 0xFF));
+        if (padding < 1)
+            data.push_back((unsigned char)(quad & 0xFF));
+    }
+    return true;
+}
+
+
+void writeJsonValue(const Json::Value &value, GeometrySink &sink, const char *key)
+{
+    switch (value.type())
+    {
+    case Json::intValue:
+    case Json::uintValue:
+        sink.writeInt(key, value.asInt64());
+        break;
+    case Json::realValue:
+        sink.writeDouble(key, value.asDouble());
+        break;
+    case Json::stringValue:
+        sink.writeString(key, value.asString());
+        break;
+    case Json::booleanValue:
+        sink.writeBool(key, value.asBool());
+        break;
+    case Json::arrayValue:
+    {
+        // Pass numeric arrays as a whole
+        bool allInts = !value.empty();
+        bool allNumbers = !value.empty();
+        for (auto &v : value)
+        {
+            allInts = allInts && (v.type() == Json::intValue || v.type() == Json::uintValue);
+            allNumbers = allNumbers && (v.type() == Json::intValue || v.type() == Json::uintValue || v.type() == Json::realValue);
+        }
+        if (allInts)
+        {
+            std::vector<Json::Int64> values;
+            for (auto &v : value)
+                values.push_back(v.asInt64());
+            sink.writeIntArray(key, values.data(), values.size());
+        }
+        else if (allNumbers)
+        {
+            std::vector<double> values;
+            for (auto &v : value)
+                values.push_back(v.asDouble());
+            sink.writeDoubleArray(key, values.data(), values.size());
+        }
+        else
+        {
+            sink.beginArray(key);
+            for (auto &v : value)
+                writeJsonValue(v, sink);
+            sink.endArray();
+        }
+        break;
+    }
+    case Json::objectValue:
+        sink.beginObject(key);
+        writeJsonMembers(value, sink);
+        sink.endObject();
+        break;
+    default:
+        // Null values do not carry any geometry data
+        break;
+    }
+}
+
+void writeJsonMembers(const Json::Value &value, GeometrySink &sink)
+{
+    for (auto it = value.begin(); it != value.end(); ++it)
+        writeJsonValue(*it, sink, it.name().c_str());
+}
@@ -0,0 +1,272 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMETRY_SINK_H
+#define GEOMETRY_SINK_H
+
+#include "common.h"
+#include <json/json.h>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#ifndef RW3DM_BINARY_VERSION
+#define RW3DM_BINARY_VERSION 3
+#endif
+
+// Encoding tag of the objects with packed buffers (little-endian values; the key of each buffer fixes its value type)
+#ifndef RW3DM_PACKED_ENCODING
+#define RW3DM_PACKED_ENCODING "packed_le_v1"
+#endif
+
+/** \brief Receives the extracted geometry data as a sequence of events.
+
+Objects and arrays are opened and closed explicitly. Inside objects, each value
+has a key; inside arrays and at the top level, the key is ignored and can be
+nullptr. Knot vectors, control points and weights are passed as whole numeric
+arrays, so that the backends do not need an intermediate tree; single
+precision coordinates are passed as float arrays, which the text backends
+write like double arrays. Packed buffers
+(e.g. mesh vertices) are passed as little-endian bytes; the text backends write
+them as base64 strings.
+*/
+class GeometrySink
+{
+public:
+    virtual ~GeometrySink() {}
+
+    // Structure
+    virtual void beginObject(const char * = nullptr) = 0;
+    virtual void endObject() = 0;
+    virtual void beginArray(const char * = nullptr) = 0;
+    virtual void endArray() = 0;
+
+    // Scalar values
+    virtual void writeBool(const char *, bool) = 0;
+    virtual void writeInt(const char *, Json::Int64) = 0;
+    virtual void writeDouble(const char *, double) = 0;
+    virtual void writeString(const char *, const std::string &) = 0;
+
+    // Numeric arrays
+    virtual void writeDoubleArray(const char *, const double *, std::size_t);
+    virtual void writeFloatArray(const char *, const float *, std::size_t);
+    virtual void writeIntArray(const char *, const Json::Int64 *, std::size_t);
+
+    // Packed buffers
+    virtual void writeBytes(const char *, const unsigned char *, std::size_t);
+};
+
+/** \brief Builds a jsoncpp tree from the sink events.
+
+If the target is an array, the top-level values are appended to it; otherwise
+the target becomes the top-level value.
+*/
+class JsonValueSink : public GeometrySink
+{
+public:
+    JsonValueSink(Json::Value &, bool = false);
+
+    void beginObject(const char * = nullptr) override;
+    void endObject() override;
+    void beginArray(const char * = nullptr) override;
+    void endArray() override;
+    void writeBool(const char *, bool) override;
+    void writeInt(const char *, Json::Int64) override;
+    void writeDouble(const char *, double) override;
+    void writeString(const char *, const std::string &) override;
+    void writeDoubleArray(const char *, const double *, std::size_t) override;
+    void writeIntArray(const char *, const Json::Int64 *, std::size_t) override;
+
+private:
+    Json::Value &slot(const char *);
+
+    Json::Value &m_target;
+    bool m_topLevelArray;
+    std::vector<Json::Value *> m_stack;
+};
+
+/** \brief Writes JSON text to an output stream while the events arrive.
+*/
+class JsonStreamSink : public GeometrySink
+{
+public:
+    JsonStreamSink(std::ostream &, int = 17, bool = false);
+
+    void beginObject(const char * = nullptr) override;
+    void endObject() override;
+    void beginArray(const char * = nullptr) override;
+    void endArray() override;
+    void writeBool(const char *, bool) override;
+    void writeInt(const char *, Json::Int64) override;
+    void writeDouble(const char *, double) override;
+    void writeString(const char *, const std::string &) override;
+    void writeDoubleArray(const char *, const double *, std::size_t) override;
+    void writeIntArray(const char *, const Json::Int64 *, std::size_t) override;
+    void writeBytes(const char *, const unsigned char *, std::size_t) override;
+
+private:
+    void beginValue(const char *);
+    void newLine();
+    void writeNumber(double);
+    void writeQuoted(const std::string &);
+
+    std::ostream &m_out;
+    int m_precision;
+    bool m_compact;
+    std::vector<bool> m_first;
+};
+
+/** \brief Writes a compact tagged binary stream.
+
+The stream starts with the magic "RW3DMBIN" and a 32-bit version number. Each
+value is a one-byte tag, followed by its key (16-bit length and bytes) when it
+is inside an object, and its payload. All numbers are little-endian. Version 2
+adds the packed byte buffers and version 3 adds the float32 arrays.
+*/
+class BinarySink : public GeometrySink
+{
+public:
+    BinarySink(std::ostream &);
+
+    void beginObject(const char * = nullptr) override;
+    void endObject() override;
+    void beginArray(const char * = nullptr) override;
+    void endArray() override;
+    void writeBool(const char *, bool) override;
+    void writeInt(const char *, Json::Int64) override;
+    void writeDouble(const char *, double) override;
+    void writeString(const char *, const std::string &) override;
+    void writeDoubleArray(const char *, const double *, std::size_t) override;
+    void writeFloatArray(const char *, const float *, std::size_t) override;
+    void writeIntArray(const char *, const Json::Int64 *, std::size_t) override;
+    void writeBytes(const char *, const unsigned char *, std::size_t) override;
+
+private:
+    void beginValue(char, const char *);
+    void writeUInt(std::uint64_t, int);
+
+    std::ostream &m_out;
+    std::vector<bool> m_inObject;
+};
+
+// Tags of the binary format
+namespace BinaryTag {
+    const char beginObject = 'O';
+    const char endObject = 'o';
+    const char beginArray = 'A';
+    const char endArray = 'a';
+    const char boolTrue = 'T';
+    const char boolFalse = 'F';
+    const char int64 = 'i';
+    const char float64 = 'd';
+    const char string = 's';
+    const char float64Array = 'D';
+    const char float32Array = 'f';
+    const char int64Array = 'I';
+    const char bytes = 'B';
+}
+
+/** \brief Records the sink events in a temporary file to replay them later.
+
+The objects of a member that follows the streamed shape data (e.g. the mesh
+objects) are collected this way, so that they are not held in memory. The
+events are written in the binary format to a file in the temporary directory,
+which is created with the first event and removed with the sink.
+*/
+class SpoolSink : public GeometrySink
+{
+public:
+    SpoolSink();
+    ~SpoolSink();
+
+    void beginObject(const char * = nullptr) override;
+    void endObject() override;
+    void beginArray(const char * = nullptr) override;
+    void endArray() override;
+    void writeBool(const char *, bool) override;
+    void writeInt(const char *, Json::Int64) override;
+    void writeDouble(const char *, double) override;
+    void writeString(const char *, const std::string &) override;
+    void writeDoubleArray(const char *, const double *, std::size_t) override;
+    void writeFloatArray(const char *, const float *, std::size_t) override;
+    void writeIntArray(const char *, const Json::Int64 *, std::size_t) override;
+    void writeBytes(const char *, const unsigned char *, std::size_t) override;
+
+    // Returns false if the temporary file cannot be written
+    bool good() const;
+
+    // Writes the recorded events to a sink in their original order; returns false if they cannot be read back
+    bool replay(GeometrySink &);
+
+private:
+    SpoolSink(const SpoolSink &) = delete;
+    SpoolSink &operator=(const SpoolSink &) = delete;
+
+    GeometrySink &spool();
+
+    std::string m_fileName;
+    std::fstream m_file;
+    std::unique_ptr<BinarySink> m_sink;
+};
+
+// Pack and unpack little-endian 32-bit or 64-bit values (floats or integers) regardless of the host byte order
+template <typename T>
+void packValues(const T *values, std::size_t count, std::vector<unsigned char> &data)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Packed buffers contain 32-bit or 64-bit values");
+    typedef typename std::conditional<sizeof(T) == 4, std::uint32_t, std::uint64_t>::type Bits;
+    data.resize(sizeof(T) * count);
+    for (std::size_t idx = 0; idx < count; idx++)
+    {
+        Bits bits;
+        std::memcpy(&bits, &values[idx], sizeof(bits));
+        for (std::size_t b = 0; b < sizeof(T); b++)
+            data[sizeof(T) * idx + b] = (unsigned char)((bits >> (8 * b)) & 0xFF);
+    }
+}
+
+template <typename T>
+void unpackValues(const unsigned char *data, std::size_t size, std::vector<T> &values)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Packed buffers contain 32-bit or 64-bit values");
+    typedef typename std::conditional<sizeof(T) == 4, std::uint32_t, std::uint64_t>::type Bits;
+    values.resize(size / sizeof(T));
+    for (std::size_t idx = 0; idx < values.size(); idx++)
+    {
+        Bits bits = 0;
+        for (std::size_t b = 0; b < sizeof(T); b++)
+            bits |= (Bits)data[sizeof(T) * idx + b] << (8 * b);
+        std::memcpy(&values[idx], &bits, sizeof(bits));
+    }
+}
+
+// Base64 encoding of the packed buffers in the text formats
+std::string encodeBase64(const unsigned char *, std::size_t);
+bool decodeBase64(const std::string &, std::vector<unsigned char> &);
+
+// Replay a jsoncpp tree (or only its members) to a sink
+void writeJsonValue(const Json::Value &, GeometrySink &, const char * = nullptr);
+void writeJsonMembers(const Json::Value &, GeometrySink &);
+
+#endif /* GEOMETRY_SINK_H */
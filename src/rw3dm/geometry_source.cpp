@@ -0,0 +1,932 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "geometry_source.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+
+// Compare a sink key with a member name
+static bool isKey(const char *key, const char *name)
+{
+    return key != nullptr && std::strcmp(key, name) == 0;
+}
+
+// Ignores all events (used for skipping unused members)
+class NullSink : public GeometrySink
+{
+public:
+    void beginObject(const char *) override {}
+    void endObject() override {}
+    void beginArray(const char *) override {}
+    void endArray() override {}
+    void writeBool(const char *, bool) override {}
+    void writeInt(const char *, Json::Int64) override {}
+    void writeDouble(const char *, double) override {}
+    void writeString(const char *, const std::string &) override {}
+    void writeDoubleArray(const char *, const double *, std::size_t) override {}
+    void writeFloatArray(const char *, const float *, std::size_t) override {}
+    void writeIntArray(const char *, const Json::Int64 *, std::size_t) override {}
+    void writeBytes(const char *, const unsigned char *, std::size_t) override {}
+};
+
+
+
+void GeometryRecord::clear()
+{
+    parametricDimension = 1;
+    type.clear();
+    dimension = 0;
+    rational = -1;
+    degree[0] = degree[1] = 0;
+    size[0] = size[1] = 0;
+    knots[0].clear();
+    knots[1].clear();
+    points.clear();
+    weights.clear();
+    stride = 0;
+    origin.clear();
+    step = 0.0;
+    deviation = 0.0;
+    hasReversed = false;
+    reversed = false;
+    trims.clear();
+    encoding.clear();
+    vertices.clear();
+    normals.clear();
+    textureCoordinates.clear();
+    faces.clear();
+}
+
+int GeometryRecord::controlPointDimension() const
+{
+    return (dimension > 0) ? dimension : stride;
+}
+
+int GeometryRecord::controlPointCount() const
+{
+    return (stride > 0) ? (int)(points.size() / stride) : 0;
+}
+
+ON_4dPoint GeometryRecord::controlPoint(int idx, int dim) const
+{
+    // Extract weight
+    double w = ((std::size_t)idx < weights.size()) ? weights[idx] : 1.0;
+
+    // Extract P (missing coordinates are zero)
+    double cpt[3] = { 0.0, 0.0, 0.0 };
+    for (int c = 0; c < dim && c < 3 && c < stride; c++)
+        cpt[c] = points[idx * stride + c];
+
+    // Dequantize coordinates
+    for (int c = 0; c < dim && c < 3 && c < (int)origin.size(); c++)
+        cpt[c] = origin[c] + cpt[c] * step;
+
+    // OpenNURBS uses Pw format
+    return ON_4dPoint(cpt[0] * w, cpt[1] * w, cpt[2] * w, w);
+}
+
+double GeometryRecord::maxDeviation() const
+{
+    double result = deviation;
+    for (auto &trim : trims)
+        result = std::max(result, trim.maxDeviation());
+    return result;
+}
+
+
+GeometryRecordBuilder::GeometryRecordBuilder(GeometryRecord &record) : m_record(record)
+{
+    m_record.clear();
+}
+
+std::vector<double> *GeometryRecordBuilder::arrayTarget(const char *key)
+{
+    if (m_stack.empty())
+        return nullptr;
+
+    Frame &top = m_stack.back();
+    GeometryRecord *record = top.record;
+    switch (top.type)
+    {
+    case FrameType::record:
+        if (isKey(key, "knotvector"))
+            return &record->knots[0];
+        if (isKey(key, "knotvector_u") || isKey(key, "knotvector_v"))
+        {
+            record->parametricDimension = std::max(record->parametricDimension, 2);
+            return &record->knots[(key[11] == 'u') ? 0 : 1];
+        }
+        if (isKey(key, "knotvector_w"))
+            record->parametricDimension = 3;
+        break;
+    case FrameType::controlPoints:
+        if (isKey(key, "points"))
+            return &record->points;
+        if (isKey(key, "weights"))
+            return &record->weights;
+        break;
+    case FrameType::quantization:
+        if (isKey(key, "origin"))
+            return &record->origin;
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+void GeometryRecordBuilder::writeNumber(const char *key, double value)
+{
+    if (m_stack.empty())
+        return;
+
+    Frame &top = m_stack.back();
+    GeometryRecord *record = top.record;
+    switch (top.type)
+    {
+    case FrameType::record:
+        if (isKey(key, "dimension"))
+            record->dimension = (int)value;
+        else if (isKey(key, "rational"))
+            record->rational = (int)value;
+        else if (isKey(key, "degree") || isKey(key, "degree_u"))
+            record->degree[0] = (int)value;
+        else if (isKey(key, "degree_v"))
+            record->degree[1] = (int)value;
+        else if (isKey(key, "size_u"))
+            record->size[0] = (int)value;
+        else if (isKey(key, "size_v"))
+            record->size[1] = (int)value;
+        else if (isKey(key, "reversed"))
+        {
+            record->hasReversed = true;
+            record->reversed = (value != 0.0);
+        }
+
+        // Surface and volume members
+        if (isKey(key, "degree_u") || isKey(key, "degree_v") || isKey(key, "size_u") || isKey(key, "size_v"))
+            record->parametricDimension = std::max(record->parametricDimension, 2);
+        else if (isKey(key, "degree_w") || isKey(key, "size_w"))
+            record->parametricDimension = 3;
+        break;
+    case FrameType::controlPoints:
+        if (isKey(key, "stride"))
+            record->stride = (int)value;
+        break;
+    case FrameType::quantization:
+        if (isKey(key, "step"))
+            record->step = value;
+        else if (isKey(key, "deviation"))
+            record->deviation = value;
+        break;
+    case FrameType::values:
+    case FrameType::points:
+        top.values->push_back(value);
+        break;
+    default:
+        break;
+    }
+}
+
+void GeometryRecordBuilder::beginObject(const char *key)
+{
+    if (m_stack.empty())
+    {
+        m_stack.push_back({ FrameType::record, &m_record, nullptr, 0 });
+        return;
+    }
+
+    Frame &top = m_stack.back();
+    Frame frame = { FrameType::skip, top.record, nullptr, 0 };
+    switch (top.type)
+    {
+    case FrameType::record:
+        if (isKey(key, "control_points"))
+            frame.type = FrameType::controlPoints;
+        else if (isKey(key, "trims"))
+            frame.type = FrameType::trims;
+        break;
+    case FrameType::controlPoints:
+        if (isKey(key, "quantization"))
+            frame.type = FrameType::quantization;
+        break;
+    case FrameType::trimList:
+        // Trim curves and the curves of container trims become child records
+        top.record->trims.emplace_back();
+        frame.type = FrameType::record;
+        frame.record = &top.record->trims.back();
+        break;
+    default:
+        break;
+    }
+    m_stack.push_back(frame);
+}
+
+void GeometryRecordBuilder::endObject()
+{
+    if (!m_stack.empty())
+        m_stack.pop_back();
+}
+
+void GeometryRecordBuilder::beginArray(const char *key)
+{
+    if (m_stack.empty())
+    {
+        m_stack.push_back({ FrameType::skip, &m_record, nullptr, 0 });
+        return;
+    }
+
+    Frame &top = m_stack.back();
+    Frame frame = { FrameType::skip, top.record, nullptr, 0 };
+    if (top.type == FrameType::points)
+    {
+        // Regular layout: a nested array for each control point
+        frame.type = FrameType::values;
+        frame.values = top.values;
+        frame.start = top.values->size();
+    }
+    else if ((top.type == FrameType::trims || top.type == FrameType::record) && isKey(key, "data"))
+        frame.type = FrameType::trimList;
+    else
+    {
+        std::vector<double> *values = arrayTarget(key);
+        if (values != nullptr)
+        {
+            frame.type = (top.type == FrameType::controlPoints && isKey(key, "points")) ? FrameType::points : FrameType::values;
+            frame.values = values;
+            frame.start = values->size();
+        }
+    }
+    m_stack.push_back(frame);
+}
+
+void GeometryRecordBuilder::endArray()
+{
+    if (m_stack.empty())
+        return;
+
+    // The size of the first nested point gives the stride of the regular layout
+    Frame frame = m_stack.back();
+    m_stack.pop_back();
+    if (!m_stack.empty() && m_stack.back().type == FrameType::points && frame.record->stride == 0)
+        frame.record->stride = (int)(frame.values->size() - frame.start);
+}
+
+void GeometryRecordBuilder::writeBool(const char *key, bool value)
+{
+    writeNumber(key, (value) ? 1.0 : 0.0);
+}
+
+void GeometryRecordBuilder::writeInt(const char *key, Json::Int64 value)
+{
+    writeNumber(key, (double)value);
+}
+
+void GeometryRecordBuilder::writeDouble(const char *key, double value)
+{
+    writeNumber(key, value);
+}
+
+void GeometryRecordBuilder::writeString(const char *key, const std::string &value)
+{
+    if (m_stack.empty() || m_stack.back().type != FrameType::record)
+        return;
+    if (isKey(key, "type"))
+        m_stack.back().record->type = value;
+    else if (isKey(key, "encoding"))
+        m_stack.back().record->encoding = value;
+    else if (isKey(key, "vertex_buffer") || isKey(key, "normal_buffer") || isKey(key, "texture_coordinate_buffer") || isKey(key, "face_buffer"))
+    {
+        // Packed buffers are base64 strings in JSON
+        std::vector<unsigned char> data;
+        if (decodeBase64(value, data))
+            writeBytes(key, data.data(), data.size());
+    }
+}
+
+void GeometryRecordBuilder::writeDoubleArray(const char *key, const double *values, std::size_t count)
+{
+    if (m_stack.empty())
+        return;
+
+    Frame &top = m_stack.back();
+    if (top.type == FrameType::points)
+    {
+        // Regular layout: a nested array for each control point
+        top.values->insert(top.values->end(), values, values + count);
+        if (top.record->stride == 0)
+            top.record->stride = (int)count;
+        return;
+    }
+
+    std::vector<double> *target = arrayTarget(key);
+    if (target != nullptr)
+        target->insert(target->end(), values, values + count);
+    else
+        GeometrySink::writeDoubleArray(key, values, count);
+}
+
+void GeometryRecordBuilder::writeIntArray(const char *key, const Json::Int64 *values, std::size_t count)
+{
+    std::vector<double> converted(values, values + count);
+    writeDoubleArray(key, converted.data(), count);
+}
+
+void GeometryRecordBuilder::writeBytes(const char *key, const unsigned char *data, std::size_t size)
+{
+    if (m_stack.empty() || m_stack.back().type != FrameType::record)
+        return;
+
+    GeometryRecord *record = m_stack.back().record;
+    if (isKey(key, "vertex_buffer"))
+        unpackValues(data, size, record->vertices);
+    else if (isKey(key, "normal_buffer"))
+        unpackValues(data, size, record->normals);
+    else if (isKey(key, "texture_coordinate_buffer"))
+        unpackValues(data, size, record->textureCoordinates);
+    else if (isKey(key, "face_buffer"))
+        unpackValues(data, size, record->faces);
+}
+
+
+// Members of the document with object data arrays, in reading order
+static const char *const objectMembers[] = { "shape", "meshes" };
+
+// The stream sources read the object data of these members
+static bool isObjectMember(const std::string &key)
+{
+    for (const char *member : objectMembers)
+    {
+        if (key == member)
+            return true;
+    }
+    return false;
+}
+
+
+JsonValueSource::JsonValueSource(const Json::Value &root) : m_root(root), m_member(0), m_index(0)
+{
+}
+
+bool JsonValueSource::next(GeometryRecord &record)
+{
+    // The mesh objects follow the shape data
+    for (; m_member < sizeof(objectMembers) / sizeof(objectMembers[0]); m_member++, m_index = 0)
+    {
+        const Json::Value &data = m_root[objectMembers[m_member]]["data"];
+        if (data.isArray() && m_index < data.size())
+        {
+            GeometryRecordBuilder builder(record);
+            writeJsonValue(data[m_index++], builder);
+            return true;
+        }
+    }
+    return false;
+}
+
+const Json::Value &JsonValueSource::blocks() const
+{
+    return m_root;
+}
+
+bool JsonValueSource::good() const
+{
+    return true;
+}
+
+
+JsonStreamSource::JsonStreamSource(std::istream &in) : m_in(in), m_state(State::start), m_good(true)
+{
+}
+
+char JsonStreamSource::peek()
+{
+    int c = m_in.peek();
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+    {
+        m_in.get();
+        c = m_in.peek();
+    }
+    return (c == std::char_traits<char>::eof()) ? '\0' : (char)c;
+}
+
+bool JsonStreamSource::expect(char c)
+{
+    if (peek() != c)
+    {
+        m_good = false;
+        return false;
+    }
+    m_in.get();
+    return true;
+}
+
+bool JsonStreamSource::readString(std::string &value)
+{
+    value.clear();
+    if (!expect('"'))
+        return false;
+
+    int c;
+    while ((c = m_in.get()) != std::char_traits<char>::eof())
+    {
+        if (c == '"')
+            return true;
+        if (c != '\\')
+        {
+            value.push_back((char)c);
+            continue;
+        }
+
+        // Escape sequences
+        c = m_in.get();
+        switch (c)
+        {
+        case 'b': value.push_back('\b'); break;
+        case 'f': value.push_back('\f'); break;
+        case 'n': value.push_back('\n'); break;
+        case 'r': value.push_back('\r'); break;
+        case 't': value.push_back('\t'); break;
+        case 'u':
+        {
+            char hex[5] = { 0 };
+            m_in.read(hex, 4);
+            unsigned long cp = std::strtoul(hex, nullptr, 16);
+            // Encode the code point in UTF-8 (surrogate pairs are not combined)
+            if (cp < 0x80)
+                value.push_back((char)cp);
+            else if (cp < 0x800)
+            {
+                value.push_back((char)(0xC0 | (cp >> 6)));
+                value.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+            else
+            {
+                value.push_back((char)(0xE0 | (cp >> 12)));
+                value.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+                value.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+            break;
+        }
+        default:
+            value.push_back((char)c);
+            break;
+        }
+    }
+    m_good = false;
+    return false;
+}
+
+bool JsonStreamSource::nextMember(char close, std::string &key)
+{
+    char c = peek();
+    if (c == ',')
+    {
+        m_in.get();
+        c = peek();
+    }
+    if (c == close)
+    {
+        m_in.get();
+        return false;
+    }
+    return readString(key) && expect(':');
+}
+
+bool JsonStreamSource::readValue(const char *key, GeometrySink &sink)
+{
+    char c = peek();
+    if (c == '{')
+    {
+        m_in.get();
+        sink.beginObject(key);
+        std::string memberKey;
+        while (nextMember('}', memberKey))
+        {
+            if (!readValue(memberKey.c_str(), sink))
+                return false;
+        }
+        sink.endObject();
+    }
+    else if (c == '[')
+    {
+        m_in.get();
+        sink.beginArray(key);
+        while (m_good)
+        {
+            c = peek();
+            if (c == ']')
+            {
+                m_in.get();
+                break;
+            }
+            if (c == ',')
+                m_in.get();
+            else if (!readValue(nullptr, sink))
+                return false;
+        }
+        sink.endArray();
+    }
+    else if (c == '"')
+    {
+        std::string value;
+        if (readString(value))
+            sink.writeString(key, value);
+    }
+    else if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        std::string token;
+        bool isFloat = false;
+        while (std::strchr("+-0123456789.eE", m_in.peek()) != nullptr && m_in.peek() != '\0')
+        {
+            c = (char)m_in.get();
+            isFloat = isFloat || c == '.' || c == 'e' || c == 'E';
+            token.push_back(c);
+        }
+        if (isFloat)
+            sink.writeDouble(key, std::strtod(token.c_str(), nullptr));
+        else
+            sink.writeInt(key, std::strtoll(token.c_str(), nullptr, 10));
+    }
+    else
+    {
+        std::string token;
+        while (std::isalpha(m_in.peek()))
+            token.push_back((char)m_in.get());
+        if (token == "true" || token == "false")
+            sink.writeBool(key, token == "true");
+        else if (token != "null")
+            m_good = false;
+    }
+    return m_good;
+}
+
+bool JsonStreamSource::next(GeometryRecord &record)
+{
+    NullSink skip;
+    std::string key;
+    while (m_good)
+    {
+        switch (m_state)
+        {
+        case State::start:
+            if (expect('{'))
+                m_state = State::rootMembers;
+            break;
+        case State::rootMembers:
+            if (!nextMember('}', key))
+                m_state = State::end;
+            else if (isObjectMember(key))
+            {
+                if (expect('{'))
+                    m_state = State::shapeMembers;
+            }
+            else if (key == "definitions" || key == "instances")
+            {
+                // Block data is small compared to the shape data, so it is kept as a tree
+                JsonValueSink sink(m_blocks[key]);
+                readValue(nullptr, sink);
+            }
+            else
+                readValue(nullptr, skip);
+            break;
+        case State::shapeMembers:
+            if (!nextMember('}', key))
+                m_state = State::rootMembers;
+            else if (key == "data")
+            {
+                if (expect('['))
+                    m_state = State::data;
+            }
+            else
+                readValue(nullptr, skip);
+            break;
+        case State::data:
+        {
+            char c = peek();
+            if (c == ']')
+            {
+                m_in.get();
+                m_state = State::shapeMembers;
+            }
+            else if (c == ',')
+                m_in.get();
+            else
+            {
+                GeometryRecordBuilder builder(record);
+                return readValue(nullptr, builder);
+            }
+            break;
+        }
+        case State::end:
+            return false;
+        }
+    }
+    return false;
+}
+
+const Json::Value &JsonStreamSource::blocks() const
+{
+    return m_blocks;
+}
+
+bool JsonStreamSource::good() const
+{
+    return m_good;
+}
+
+
+BinarySource::BinarySource(std::istream &in) : m_in(in), m_state(State::start), m_good(true)
+{
+}
+
+bool BinarySource::readUInt(std::uint64_t &value, int numBytes)
+{
+    unsigned char buffer[8];
+    if (!m_in.read((char *)buffer, numBytes))
+    {
+        m_good = false;
+        return false;
+    }
+    value = 0;
+    for (int idx = numBytes - 1; idx >= 0; idx--)
+        value = (value << 8) | buffer[idx];
+    return true;
+}
+
+bool BinarySource::readKey(std::string &key)
+{
+    std::uint64_t length;
+    if (!readUInt(length, 2))
+        return false;
+    key.resize((std::size_t)length);
+    if (length > 0 && !m_in.read(&key[0], length))
+        m_good = false;
+    return m_good;
+}
+
+bool BinarySource::nextMember(char endTag, char &tag, std::string &key)
+{
+    int c = m_in.get();
+    if (c == std::char_traits<char>::eof())
+    {
+        m_good = false;
+        return false;
+    }
+    if ((char)c == endTag)
+        return false;
+    tag = (char)c;
+    return readKey(key);
+}
+
+bool BinarySource::readValue(char tag, const char *key, GeometrySink &sink)
+{
+    std::uint64_t value;
+    switch (tag)
+    {
+    case BinaryTag::beginObject:
+    {
+        sink.beginObject(key);
+        char memberTag;
+        std::string memberKey;
+        while (nextMember(BinaryTag::endObject, memberTag, memberKey))
+        {
+            if (!readValue(memberTag, memberKey.c_str(), sink))
+                return false;
+        }
+        sink.endObject();
+        break;
+    }
+    case BinaryTag::beginArray:
+    {
+        sink.beginArray(key);
+        int c;
+        while ((c = m_in.get()) != BinaryTag::endArray)
+        {
+            if (c == std::char_traits<char>::eof())
+            {
+                m_good = false;
+                return false;
+            }
+            if (!readValue((char)c, nullptr, sink))
+                return false;
+        }
+        sink.endArray();
+        break;
+    }
+    case BinaryTag::boolTrue:
+    case BinaryTag::boolFalse:
+        sink.writeBool(key, tag == BinaryTag::boolTrue);
+        break;
+    case BinaryTag::int64:
+        if (readUInt(value, 8))
+            sink.writeInt(key, (Json::Int64)value);
+        break;
+    case BinaryTag::float64:
+        if (readUInt(value, 8))
+        {
+            double d;
+            std::memcpy(&d, &value, sizeof(d));
+            sink.writeDouble(key, d);
+        }
+        break;
+    case BinaryTag::string:
+        if (readUInt(value, 4))
+        {
+            std::string s((std::size_t)value, '\0');
+            if (value > 0 && !m_in.read(&s[0], value))
+                m_good = false;
+            else
+                sink.writeString(key, s);
+        }
+        break;
+    case BinaryTag::bytes:
+    {
+        std::uint64_t size;
+        if (!readUInt(size, 8))
+            break;
+        // Read in blocks, so that a corrupt size cannot allocate unbounded memory
+        std::vector<unsigned char> data;
+        const std::uint64_t blockSize = 1 << 20;
+        while (data.size() < size)
+        {
+            std::size_t offset = data.size();
+            std::size_t length = (std::size_t)std::min(blockSize, size - offset);
+            data.resize(offset + length);
+            if (!m_in.read((char *)data.data() + offset, length))
+            {
+                m_good = false;
+                break;
+            }
+        }
+        if (m_good)
+            sink.writeBytes(key, data.data(), data.size());
+        break;
+    }
+    case BinaryTag::float32Array:
+    {
+        std::uint64_t count;
+        if (!readUInt(count, 8))
+            break;
+        // Read element by element, so that a corrupt count cannot allocate unbounded memory
+        std::vector<float> floats;
+        for (std::uint64_t idx = 0; idx < count && readUInt(value, 4); idx++)
+        {
+            std::uint32_t bits = (std::uint32_t)value;
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            floats.push_back(f);
+        }
+        if (m_good)
+            sink.writeFloatArray(key, floats.data(), floats.size());
+        break;
+    }
+    case BinaryTag::float64Array:
+    case BinaryTag::int64Array:
+    {
+        std::uint64_t count;
+        if (!readUInt(count, 8))
+            break;
+        // Read element by element, so that a corrupt count cannot allocate unbounded memory
+        std::vector<double> doubles;
+        std::vector<Json::Int64> ints;
+        for (std::uint64_t idx = 0; idx < count && readUInt(value, 8); idx++)
+        {
+            if (tag == BinaryTag::float64Array)
+            {
+                double d;
+                std::memcpy(&d, &value, sizeof(d));
+                doubles.push_back(d);
+            }
+            else
+                ints.push_back((Json::Int64)value);
+        }
+        if (!m_good)
+            break;
+        if (tag == BinaryTag::float64Array)
+            sink.writeDoubleArray(key, doubles.data(), doubles.size());
+        else
+            sink.writeIntArray(key, ints.data(), ints.size());
+        break;
+    }
+    default:
+        m_good = false;
+        break;
+    }
+    return m_good;
+}
+
+bool BinarySource::next(GeometryRecord &record)
+{
+    NullSink skip;
+    char tag;
+    std::string key;
+    while (m_good)
+    {
+        switch (m_state)
+        {
+        case State::start:
+        {
+            char magic[8];
+            std::uint64_t version;
+            if (!m_in.read(magic, 8) || std::memcmp(magic, "RW3DMBIN", 8) != 0 || !readUInt(version, 4) || version > RW3DM_BINARY_VERSION || m_in.get() != BinaryTag::beginObject)
+                m_good = false;
+            else
+                m_state = State::rootMembers;
+            break;
+        }
+        case State::rootMembers:
+            if (!nextMember(BinaryTag::endObject, tag, key))
+                m_state = State::end;
+            else if (isObjectMember(key) && tag == BinaryTag::beginObject)
+                m_state = State::shapeMembers;
+            else if (key == "definitions" || key == "instances")
+            {
+                // Block data is small compared to the shape data, so it is kept as a tree
+                JsonValueSink sink(m_blocks[key]);
+                readValue(tag, nullptr, sink);
+            }
+            else
+                readValue(tag, nullptr, skip);
+            break;
+        case State::shapeMembers:
+            if (!nextMember(BinaryTag::endObject, tag, key))
+                m_state = State::rootMembers;
+            else if (key == "data" && tag == BinaryTag::beginArray)
+                m_state = State::data;
+            else
+                readValue(tag, nullptr, skip);
+            break;
+        case State::data:
+        {
+            int c = m_in.get();
+            if (c == BinaryTag::endArray)
+                m_state = State::shapeMembers;
+            else if (c == std::char_traits<char>::eof())
+                m_good = false;
+            else
+            {
+                GeometryRecordBuilder builder(record);
+                return readValue((char)c, nullptr, builder);
+            }
+            break;
+        }
+        case State::end:
+            return false;
+        }
+    }
+    return false;
+}
+
+bool BinarySource::readValues(GeometrySink &sink)
+{
+    char magic[8];
+    std::uint64_t version;
+    if (!m_in.read(magic, 8) || std::memcmp(magic, "RW3DMBIN", 8) != 0 || !readUInt(version, 4) || version > RW3DM_BINARY_VERSION)
+        m_good = false;
+
+    int c;
+    while (m_good && (c = m_in.get()) != std::char_traits<char>::eof())
+        readValue((char)c, nullptr, sink);
+    m_state = State::end;
+    return m_good;
+}
+
+const Json::Value &BinarySource::blocks() const
+{
+    return m_blocks;
+}
+
+bool BinarySource::good() const
+{
+    return m_good;
+}
+
+
+bool isBinaryGeometryData(const std::string &data)
+{
+    return data.compare(0, 8, "RW3DMBIN") == 0;
+}
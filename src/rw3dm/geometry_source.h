@@ -0,0 +1,202 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GEOMETRY_SOURCE_H
+#define GEOMETRY_SOURCE_H
+
+#include "common.h"
+#include "geometry_sink.h"
+#include <opennurbs_public.h>
+#include <json/json.h>
+
+/** \brief NURBS curve or surface data in contiguous buffers.
+
+Curves use only the first parametric direction. Knot vectors include the
+superfluous knots as in geomdl. Control point coordinates are stored with a
+stride and dequantized on access. Trim curves (and the curves of container
+trims) are stored as child records. Mesh objects (type "mesh") store the
+encoding tag and the unpacked contents of their packed vertex, normal, texture
+coordinate and face buffers.
+*/
+struct GeometryRecord {
+    int parametricDimension = 1;
+    std::string type;
+    int dimension = 0;
+    int rational = -1;
+    int degree[2] = { 0, 0 };
+    int size[2] = { 0, 0 };
+    std::vector<double> knots[2];
+    std::vector<double> points;
+    std::vector<double> weights;
+    int stride = 0;
+    std::vector<double> origin;
+    double step = 0.0;
+    double deviation = 0.0;
+    bool hasReversed = false;
+    bool reversed = false;
+    std::vector<GeometryRecord> trims;
+    std::string encoding;
+    std::vector<float> vertices;
+    std::vector<float> normals;
+    std::vector<float> textureCoordinates;
+    std::vector<std::int32_t> faces;
+
+    // Resets the record, keeping the allocated buffers
+    void clear();
+
+    int controlPointDimension() const;
+    int controlPointCount() const;
+    ON_4dPoint controlPoint(int, int) const;
+    double maxDeviation() const;
+};
+
+/** \brief Builds a geometry record from the sink events of a single geomdl object.
+*/
+class GeometryRecordBuilder : public GeometrySink
+{
+public:
+    GeometryRecordBuilder(GeometryRecord &);
+
+    void beginObject(const char * = nullptr) override;
+    void endObject() override;
+    void beginArray(const char * = nullptr) override;
+    void endArray() override;
+    void writeBool(const char *, bool) override;
+    void writeInt(const char *, Json::Int64) override;
+    void writeDouble(const char *, double) override;
+    void writeString(const char *, const std::string &) override;
+    void writeDoubleArray(const char *, const double *, std::size_t) override;
+    void writeIntArray(const char *, const Json::Int64 *, std::size_t) override;
+    void writeBytes(const char *, const unsigned char *, std::size_t) override;
+
+private:
+    enum class FrameType { record, controlPoints, quantization, trims, trimList, values, points, skip };
+    struct Frame {
+        FrameType type;
+        GeometryRecord *record;
+        std::vector<double> *values;
+        std::size_t start;
+    };
+
+    std::vector<double> *arrayTarget(const char *);
+    void writeNumber(const char *, double);
+
+    GeometryRecord &m_record;
+    std::vector<Frame> m_stack;
+};
+
+/** \brief Provides the objects of a geomdl document one at a time.
+
+The objects of the shape data are followed by the mesh objects of the "meshes"
+member.
+*/
+class GeometrySource
+{
+public:
+    virtual ~GeometrySource() {}
+
+    // Reads the next object; returns false when there are no more objects
+    virtual bool next(GeometryRecord &) = 0;
+
+    // Block definitions and instances of the document (available after all objects are read)
+    virtual const Json::Value &blocks() const = 0;
+
+    // Returns false if the input is malformed
+    virtual bool good() const = 0;
+};
+
+/** \brief Reads the objects from a jsoncpp tree.
+*/
+class JsonValueSource : public GeometrySource
+{
+public:
+    JsonValueSource(const Json::Value &);
+
+    bool next(GeometryRecord &) override;
+    const Json::Value &blocks() const override;
+    bool good() const override;
+
+private:
+    const Json::Value &m_root;
+    std::size_t m_member;
+    Json::ArrayIndex m_index;
+};
+
+/** \brief Reads the objects from JSON text without building the document tree.
+*/
+class JsonStreamSource : public GeometrySource
+{
+public:
+    JsonStreamSource(std::istream &);
+
+    bool next(GeometryRecord &) override;
+    const Json::Value &blocks() const override;
+    bool good() const override;
+
+private:
+    enum class State { start, rootMembers, shapeMembers, data, end };
+
+    char peek();
+    bool expect(char);
+    bool readString(std::string &);
+    bool readValue(const char *, GeometrySink &);
+    bool nextMember(char, std::string &);
+
+    std::istream &m_in;
+    State m_state;
+    bool m_good;
+    Json::Value m_blocks;
+};
+
+/** \brief Reads the objects from the tagged binary format written by BinarySink.
+*/
+class BinarySource : public GeometrySource
+{
+public:
+    BinarySource(std::istream &);
+
+    bool next(GeometryRecord &) override;
+    const Json::Value &blocks() const override;
+    bool good() const override;
+
+    // Writes all top-level values of a stream without a document (e.g. a spooled member) to a sink
+    bool readValues(GeometrySink &);
+
+private:
+    enum class State { start, rootMembers, shapeMembers, data, end };
+
+    bool readUInt(std::uint64_t &, int);
+    bool readKey(std::string &);
+    bool readValue(char, const char *, GeometrySink &);
+    bool nextMember(char, char &, std::string &);
+
+    std::istream &m_in;
+    State m_state;
+    bool m_good;
+    Json::Value m_blocks;
+};
+
+// Format detection
+bool isBinaryGeometryData(const std::string &);
+
+#endif /* GEOMETRY_SOURCE_H */
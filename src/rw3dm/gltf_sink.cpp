@@ -0,0 +1,562 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gltf_sink.h"
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+
+// glTF constants
+namespace GltfConstant {
+    const int arrayBuffer = 34962;
+    const int elementArrayBuffer = 34963;
+    const int byte = 5120;
+    const int unsignedShort = 5123;
+    const int unsignedInt = 5125;
+    const int float32 = 5126;
+    const int triangles = 4;
+}
+
+// Append a little-endian unsigned integer regardless of the host byte order
+static void appendUInt(std::vector<unsigned char> &buffer, std::uint64_t value, int numBytes)
+{
+    for (int b = 0; b < numBytes; b++)
+        buffer.push_back((unsigned char)((value >> (8 * b)) & 0xFF));
+}
+
+static void appendFloat(std::vector<unsigned char> &buffer, float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendUInt(buffer, bits, 4);
+}
+
+static bool keyIs(const char *key, const char *name)
+{
+    return key != nullptr && std::strcmp(key, name) == 0;
+}
+
+static Json::Value vec3(const double *values)
+{
+    Json::Value v(Json::arrayValue);
+    for (int i = 0; i < 3; i++)
+        v.append(values[i]);
+    return v;
+}
+
+
+GlbSink::GlbSink(std::ostream &out, bool quantize) : m_out(out), m_quantize(quantize),
+    m_bufferViews(Json::arrayValue), m_accessors(Json::arrayValue), m_meshes(Json::arrayValue)
+{
+}
+
+GlbSink::Context GlbSink::childContext(const char *key, bool isObject) const
+{
+    if (m_stack.empty())
+        return (isObject) ? Context::root : Context::ignore;
+
+    switch (m_stack.back().context)
+    {
+    case Context::root:
+        // Mesh objects have the same layout as the shape data
+        if ((keyIs(key, "shape") || keyIs(key, "meshes")) && isObject)
+            return Context::shape;
+        if (keyIs(key, "definitions") && !isObject)
+            return Context::definitions;
+        if (keyIs(key, "instances") && !isObject)
+            return Context::instances;
+        break;
+    case Context::shape:
+        if (keyIs(key, "data") && !isObject)
+            return Context::data;
+        break;
+    case Context::data:
+    case Context::definitionData:
+        if (isObject)
+            return Context::object;
+        break;
+    case Context::object:
+        if (keyIs(key, "mesh") && isObject)
+            return Context::mesh;
+        break;
+    case Context::definitions:
+        if (isObject)
+            return Context::definition;
+        break;
+    case Context::definition:
+        if (keyIs(key, "data") && !isObject)
+            return Context::definitionData;
+        if (keyIs(key, "instances") && !isObject)
+            return Context::instances;
+        break;
+    case Context::instances:
+        if (isObject)
+            return Context::instance;
+        break;
+    default:
+        break;
+    }
+    return Context::ignore;
+}
+
+void GlbSink::push(const char *key, bool isObject)
+{
+    Frame frame;
+    frame.context = childContext(key, isObject);
+    frame.inDefinition = (frame.context == Context::definition) || (!m_stack.empty() && m_stack.back().inDefinition);
+    m_stack.push_back(frame);
+}
+
+void GlbSink::beginObject(const char *key)
+{
+    push(key, true);
+    switch (m_stack.back().context)
+    {
+    case Context::object:
+        m_vertices.clear();
+        m_normals.clear();
+        m_indices.clear();
+        break;
+    case Context::definition:
+        m_definitions.emplace_back();
+        break;
+    case Context::instance:
+        // Identity transformation unless the instance has one
+        m_instance.definition = -1;
+        for (int i = 0; i < 16; i++)
+            m_instance.matrix[i] = (i % 5 == 0) ? 1.0 : 0.0;
+        break;
+    default:
+        break;
+    }
+}
+
+void GlbSink::endObject()
+{
+    if (m_stack.empty())
+        return;
+    Frame frame = m_stack.back();
+    m_stack.pop_back();
+
+    if (frame.context == Context::object)
+    {
+        MeshNode meshNode;
+        if (addMesh(meshNode))
+        {
+            if (frame.inDefinition)
+                m_definitions.back().members.push_back(meshNode);
+            else
+                m_objects.push_back(meshNode);
+        }
+    }
+    else if (frame.context == Context::instance && m_instance.definition >= 0)
+    {
+        if (frame.inDefinition)
+            m_definitions.back().instances.push_back(m_instance);
+        else
+            m_instances.push_back(m_instance);
+    }
+}
+
+void GlbSink::beginArray(const char *key)
+{
+    push(key, false);
+}
+
+void GlbSink::endArray()
+{
+    if (!m_stack.empty())
+        m_stack.pop_back();
+}
+
+void GlbSink::writeBool(const char *, bool)
+{
+}
+
+void GlbSink::writeInt(const char *key, Json::Int64 value)
+{
+    if (!m_stack.empty() && m_stack.back().context == Context::instance && keyIs(key, "definition"))
+        m_instance.definition = value;
+}
+
+void GlbSink::writeDouble(const char *, double)
+{
+}
+
+void GlbSink::writeString(const char *key, const std::string &value)
+{
+    // Packed buffers of the mesh objects are base64 strings if they are replayed from a jsoncpp tree
+    if (m_stack.empty() || m_stack.back().context != Context::object)
+        return;
+    if (keyIs(key, "vertex_buffer") || keyIs(key, "normal_buffer") || keyIs(key, "face_buffer"))
+    {
+        std::vector<unsigned char> data;
+        if (decodeBase64(value, data))
+            writeBytes(key, data.data(), data.size());
+    }
+}
+
+void GlbSink::writeDoubleArray(const char *key, const double *values, std::size_t count)
+{
+    if (m_stack.empty())
+        return;
+    Context context = m_stack.back().context;
+    if (context == Context::object || context == Context::mesh)
+    {
+        if (keyIs(key, "vertices"))
+            m_vertices.assign(values, values + count);
+        else if (keyIs(key, "normals"))
+            m_normals.assign(values, values + count);
+        else if (keyIs(key, "indices"))
+        {
+            m_indices.resize(count);
+            for (std::size_t idx = 0; idx < count; idx++)
+                m_indices[idx] = (Json::Int64)values[idx];
+        }
+    }
+    else if (context == Context::instance && keyIs(key, "xform"))
+        setMatrix(values, count);
+}
+
+void GlbSink::writeIntArray(const char *key, const Json::Int64 *values, std::size_t count)
+{
+    if (m_stack.empty())
+        return;
+    Context context = m_stack.back().context;
+    if ((context == Context::object || context == Context::mesh) && keyIs(key, "indices"))
+        m_indices.assign(values, values + count);
+    else if (context == Context::object || context == Context::mesh || context == Context::instance)
+    {
+        // Integral coordinates may arrive as integer arrays
+        std::vector<double> converted(values, values + count);
+        writeDoubleArray(key, converted.data(), count);
+    }
+}
+
+void GlbSink::writeBytes(const char *key, const unsigned char *data, std::size_t size)
+{
+    if (m_stack.empty() || m_stack.back().context != Context::object)
+        return;
+    if (keyIs(key, "vertex_buffer") || keyIs(key, "normal_buffer"))
+    {
+        std::vector<float> values;
+        unpackValues(data, size, values);
+        std::vector<double> &target = (keyIs(key, "vertex_buffer")) ? m_vertices : m_normals;
+        target.assign(values.begin(), values.end());
+    }
+    else if (keyIs(key, "face_buffer"))
+    {
+        // Mesh faces are quads; triangles repeat their third vertex index
+        std::vector<std::int32_t> faces;
+        unpackValues(data, size, faces);
+        m_indices.clear();
+        for (std::size_t idx = 0; idx + 3 < faces.size(); idx += 4)
+        {
+            const std::int32_t *vi = &faces[idx];
+            m_indices.insert(m_indices.end(), { vi[0], vi[1], vi[2] });
+            if (vi[2] != vi[3])
+                m_indices.insert(m_indices.end(), { vi[0], vi[2], vi[3] });
+        }
+    }
+}
+
+void GlbSink::setMatrix(const double *xform, std::size_t count)
+{
+    if (count != 16)
+        return;
+    // Row-major to column-major
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++)
+            m_instance.matrix[c * 4 + r] = xform[r * 4 + c];
+    }
+}
+
+void GlbSink::align()
+{
+    while (m_buffer.size() % 4 != 0)
+        m_buffer.push_back(0);
+}
+
+int GlbSink::addBufferView(std::size_t offset, std::size_t length, int stride, int target)
+{
+    Json::Value view;
+    view["buffer"] = 0;
+    view["byteOffset"] = (Json::UInt64)offset;
+    view["byteLength"] = (Json::UInt64)length;
+    if (stride > 0)
+        view["byteStride"] = stride;
+    view["target"] = target;
+    m_bufferViews.append(view);
+    return (int)m_bufferViews.size() - 1;
+}
+
+bool GlbSink::addMesh(MeshNode &meshNode)
+{
+    std::size_t numVertices = m_vertices.size() / 3;
+    if (numVertices == 0 || m_vertices.size() % 3 != 0 || m_indices.empty() || m_indices.size() % 3 != 0)
+        return false;
+    for (auto idx : m_indices)
+    {
+        if (idx < 0 || (std::size_t)idx >= numVertices)
+            return false;
+    }
+    bool hasNormals = (m_normals.size() == m_vertices.size());
+
+    // Positions are relative to the minimum of the bounding box, which keeps the precision of the 32-bit floats far from the origin
+    double minPt[3], maxPt[3];
+    for (int c = 0; c < 3; c++)
+    {
+        minPt[c] = std::numeric_limits<double>::max();
+        maxPt[c] = std::numeric_limits<double>::lowest();
+    }
+    for (std::size_t v = 0; v < numVertices; v++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            minPt[c] = std::min(minPt[c], m_vertices[3 * v + c]);
+            maxPt[c] = std::max(maxPt[c], m_vertices[3 * v + c]);
+        }
+    }
+    double extent = std::max(maxPt[0] - minPt[0], std::max(maxPt[1] - minPt[1], maxPt[2] - minPt[2]));
+
+    // Quantized positions use a uniform scale, so that the normals do not need to be corrected
+    meshNode.scale = (m_quantize && extent > 0.0) ? extent / 65535.0 : 1.0;
+    for (int c = 0; c < 3; c++)
+        meshNode.translation[c] = minPt[c];
+
+    // Interleaved vertex data; the attributes are aligned to 4 bytes
+    int stride = (m_quantize) ? ((hasNormals) ? 12 : 8) : ((hasNormals) ? 24 : 12);
+    align();
+    std::size_t vertexOffset = m_buffer.size();
+    double storedMin[3] = { 0.0, 0.0, 0.0 };
+    double storedMax[3] = { 0.0, 0.0, 0.0 };
+    for (std::size_t v = 0; v < numVertices; v++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            double value = (m_vertices[3 * v + c] - minPt[c]) / meshNode.scale;
+            if (m_quantize)
+            {
+                value = std::round(std::min(std::max(value, 0.0), 65535.0));
+                appendUInt(m_buffer, (std::uint64_t)value, 2);
+            }
+            else
+            {
+                value = (float)value;
+                appendFloat(m_buffer, (float)value);
+            }
+            storedMin[c] = (v == 0) ? value : std::min(storedMin[c], value);
+            storedMax[c] = (v == 0) ? value : std::max(storedMax[c], value);
+        }
+        if (m_quantize)
+            appendUInt(m_buffer, 0, 2);
+        if (hasNormals)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                double value = m_normals[3 * v + c];
+                if (m_quantize)
+                    m_buffer.push_back((unsigned char)(std::int8_t)std::round(std::min(std::max(value, -1.0), 1.0) * 127.0));
+                else
+                    appendFloat(m_buffer, (float)value);
+            }
+            if (m_quantize)
+                m_buffer.push_back(0);
+        }
+    }
+    int vertexView = addBufferView(vertexOffset, numVertices * stride, stride, GltfConstant::arrayBuffer);
+
+    Json::Value attributes;
+    Json::Value position;
+    position["bufferView"] = vertexView;
+    position["byteOffset"] = 0;
+    position["componentType"] = (m_quantize) ? GltfConstant::unsignedShort : GltfConstant::float32;
+    position["count"] = (Json::UInt64)numVertices;
+    position["type"] = "VEC3";
+    position["min"] = vec3(storedMin);
+    position["max"] = vec3(storedMax);
+    m_accessors.append(position);
+    attributes["POSITION"] = (int)m_accessors.size() - 1;
+    if (hasNormals)
+    {
+        Json::Value normal;
+        normal["bufferView"] = vertexView;
+        normal["byteOffset"] = (m_quantize) ? 8 : 12;
+        normal["componentType"] = (m_quantize) ? GltfConstant::byte : GltfConstant::float32;
+        if (m_quantize)
+            normal["normalized"] = true;
+        normal["count"] = (Json::UInt64)numVertices;
+        normal["type"] = "VEC3";
+        m_accessors.append(normal);
+        attributes["NORMAL"] = (int)m_accessors.size() - 1;
+    }
+
+    // 16-bit indices if the largest index fits below the restart value
+    bool shortIndices = (numVertices <= 65535);
+    align();
+    std::size_t indexOffset = m_buffer.size();
+    for (auto idx : m_indices)
+        appendUInt(m_buffer, (std::uint64_t)idx, (shortIndices) ? 2 : 4);
+    int indexView = addBufferView(indexOffset, m_buffer.size() - indexOffset, 0, GltfConstant::elementArrayBuffer);
+
+    Json::Value indices;
+    indices["bufferView"] = indexView;
+    indices["byteOffset"] = 0;
+    indices["componentType"] = (shortIndices) ? GltfConstant::unsignedShort : GltfConstant::unsignedInt;
+    indices["count"] = (Json::UInt64)m_indices.size();
+    indices["type"] = "SCALAR";
+    m_accessors.append(indices);
+
+    Json::Value primitive;
+    primitive["attributes"] = attributes;
+    primitive["indices"] = (int)m_accessors.size() - 1;
+    primitive["mode"] = GltfConstant::triangles;
+    Json::Value mesh;
+    mesh["primitives"].append(primitive);
+    m_meshes.append(mesh);
+    meshNode.mesh = (int)m_meshes.size() - 1;
+    return true;
+}
+
+int GlbSink::writeMeshNode(const MeshNode &meshNode, Json::Value &nodes) const
+{
+    Json::Value node;
+    node["mesh"] = meshNode.mesh;
+    node["translation"] = vec3(meshNode.translation);
+    if (meshNode.scale != 1.0)
+    {
+        double scale[3] = { meshNode.scale, meshNode.scale, meshNode.scale };
+        node["scale"] = vec3(scale);
+    }
+    nodes.append(node);
+    return (int)nodes.size() - 1;
+}
+
+int GlbSink::writeInstanceNode(const Instance &instance, int depth, Json::Value &nodes) const
+{
+    if (instance.definition < 0 || (std::size_t)instance.definition >= m_definitions.size() || depth >= RW3DM_GLB_MAX_NESTING)
+        return -1;
+    const Definition &definition = m_definitions[(std::size_t)instance.definition];
+
+    // Nodes cannot have more than one parent, so each instance gets its own nodes sharing the meshes of the definition
+    int nodeIdx = (int)nodes.size();
+    nodes.append(Json::Value(Json::objectValue));
+    Json::Value children(Json::arrayValue);
+    for (auto &member : definition.members)
+        children.append(writeMeshNode(member, nodes));
+    for (auto &nested : definition.instances)
+    {
+        int childIdx = writeInstanceNode(nested, depth + 1, nodes);
+        if (childIdx >= 0)
+            children.append(childIdx);
+    }
+
+    Json::Value &node = nodes[nodeIdx];
+    for (int i = 0; i < 16; i++)
+        node["matrix"].append(instance.matrix[i]);
+    if (!children.empty())
+        node["children"] = children;
+    return nodeIdx;
+}
+
+bool GlbSink::finish()
+{
+    // The root node converts the Z-up model to the Y-up glTF coordinate system
+    Json::Value nodes(Json::arrayValue);
+    nodes.append(Json::Value(Json::objectValue));
+    Json::Value children(Json::arrayValue);
+    for (auto &meshNode : m_objects)
+        children.append(writeMeshNode(meshNode, nodes));
+    for (auto &instance : m_instances)
+    {
+        int childIdx = writeInstanceNode(instance, 0, nodes);
+        if (childIdx >= 0)
+            children.append(childIdx);
+    }
+    Json::Value &root = nodes[0];
+    root["name"] = "rw3dm";
+    double halfSqrt2 = std::sqrt(0.5);
+    root["rotation"].append(-halfSqrt2);
+    root["rotation"].append(0.0);
+    root["rotation"].append(0.0);
+    root["rotation"].append(halfSqrt2);
+    if (!children.empty())
+        root["children"] = children;
+
+    // Empty arrays are not allowed in the document
+    align();
+    Json::Value doc;
+    doc["asset"]["version"] = "2.0";
+    doc["asset"]["generator"] = "rw3dm";
+    doc["scene"] = 0;
+    doc["scenes"][0]["nodes"].append(0);
+    doc["nodes"] = nodes;
+    if (!m_meshes.empty())
+    {
+        doc["meshes"] = m_meshes;
+        doc["accessors"] = m_accessors;
+        doc["bufferViews"] = m_bufferViews;
+        doc["buffers"][0]["byteLength"] = (Json::UInt64)m_buffer.size();
+        if (m_quantize)
+        {
+            doc["extensionsUsed"].append("KHR_mesh_quantization");
+            doc["extensionsRequired"].append("KHR_mesh_quantization");
+        }
+    }
+
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    std::string json = Json::writeString(wbuilder, doc);
+    while (json.size() % 4 != 0)
+        json.push_back(' ');
+
+    // The file length is a 32-bit value
+    std::uint64_t length = 12 + 8 + json.size() + ((m_buffer.empty()) ? 0 : 8 + m_buffer.size());
+    if (length > 0xFFFFFFFFull)
+        return false;
+
+    std::vector<unsigned char> header;
+    appendUInt(header, 0x46546C67, 4); // "glTF"
+    appendUInt(header, 2, 4);
+    appendUInt(header, length, 4);
+    appendUInt(header, json.size(), 4);
+    appendUInt(header, 0x4E4F534A, 4); // "JSON"
+    m_out.write((const char *)header.data(), header.size());
+    m_out.write(json.data(), json.size());
+    if (!m_buffer.empty())
+    {
+        header.clear();
+        appendUInt(header, m_buffer.size(), 4);
+        appendUInt(header, 0x004E4942, 4); // "BIN"
+        m_out.write((const char *)header.data(), header.size());
+        m_out.write((const char *)m_buffer.data(), m_buffer.size());
+    }
+    return !m_out.fail();
+}
+
+std::size_t GlbSink::meshCount() const
+{
+    return m_meshes.size();
+}
@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GLTF_SINK_H
+#define GLTF_SINK_H
+
+#include "common.h"
+#include "geometry_sink.h"
+
+// Maximum nesting depth of the block instances (deeper references are dropped)
+#ifndef RW3DM_GLB_MAX_NESTING
+#define RW3DM_GLB_MAX_NESTING 32
+#endif
+
+/** \brief Collects the triangle meshes of the extracted objects and writes a binary glTF (.glb) file.
+
+The meshes are read from the "vertices", "normals" and "indices" arrays of the
+shape data objects or their "mesh" members, and from the packed buffers
+("vertex_buffer", "normal_buffer" and "face_buffer") of the mesh objects in
+the "meshes" member; objects without a mesh are skipped.
+Each mesh gets its own vertex buffer view (interleaved positions and normals)
+and index buffer view. The positions are stored relative to the minimum of
+their bounding box, either as 32-bit floats or, if quantization is enabled, as
+16-bit integers (KHR_mesh_quantization); the node of the mesh restores them.
+
+The meshes of the block definitions are written once and each block instance
+becomes a node tree referencing them. The data is kept in memory until finish()
+writes the file.
+*/
+class GlbSink : public GeometrySink
+{
+public:
+    GlbSink(std::ostream &, bool = false);
+
+    void beginObject(const char * = nullptr) override;
+    void endObject() override;
+    void beginArray(const char * = nullptr) override;
+    void endArray() override;
+    void writeBool(const char *, bool) override;
+    void writeInt(const char *, Json::Int64) override;
+    void writeDouble(const char *, double) override;
+    void writeString(const char *, const std::string &) override;
+    void writeDoubleArray(const char *, const double *, std::size_t) override;
+    void writeIntArray(const char *, const Json::Int64 *, std::size_t) override;
+    void writeBytes(const char *, const unsigned char *, std::size_t) override;
+
+    // Writes the glTF document and its binary buffer; returns false if the file would exceed the size limit of the format
+    bool finish();
+
+    // Number of meshes written to the buffer
+    std::size_t meshCount() const;
+
+private:
+    // Position of the events in the document
+    enum class Context {
+        ignore,
+        root,
+        shape,
+        data,
+        object,
+        mesh,
+        definitions,
+        definition,
+        definitionData,
+        instances,
+        instance
+    };
+
+    struct Frame {
+        Context context;
+        bool inDefinition;
+    };
+
+    // Mesh with the translation and the uniform scale restoring its positions
+    struct MeshNode {
+        int mesh;
+        double translation[3];
+        double scale;
+    };
+
+    // Block instance as a definition index and a column-major 4x4 transformation
+    struct Instance {
+        Json::Int64 definition;
+        double matrix[16];
+    };
+
+    struct Definition {
+        std::vector<MeshNode> members;
+        std::vector<Instance> instances;
+    };
+
+    Context childContext(const char *, bool) const;
+    void push(const char *, bool);
+    void setMatrix(const double *, std::size_t);
+    bool addMesh(MeshNode &);
+    int addBufferView(std::size_t, std::size_t, int, int);
+    void align();
+    int writeMeshNode(const MeshNode &, Json::Value &) const;
+    int writeInstanceNode(const Instance &, int, Json::Value &) const;
+
+    std::ostream &m_out;
+    bool m_quantize;
+    std::vector<Frame> m_stack;
+
+    // Current mesh and instance
+    std::vector<double> m_vertices;
+    std::vector<double> m_normals;
+    std::vector<Json::Int64> m_indices;
+    Instance m_instance;
+
+    // Document
+    std::vector<unsigned char> m_buffer;
+    Json::Value m_bufferViews;
+    Json::Value m_accessors;
+    Json::Value m_meshes;
+    std::vector<MeshNode> m_objects;
+    std::vector<Definition> m_definitions;
+    std::vector<Instance> m_instances;
+};
+
+#endif /* GLTF_SINK_H */
@@ -0,0 +1,195 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "instances.h"
+
+
+void InstanceTable::addMemberGeometry(const std::string &objectId, const Json::Value &data)
+{
+    m_memberGeometry[objectId] = data;
+}
+
+void InstanceTable::addMemberReference(const std::string &objectId, const InstanceReference &reference)
+{
+    m_memberReferences[objectId] = reference;
+}
+
+void InstanceTable::addReference(const InstanceReference &reference)
+{
+    m_references.push_back(reference);
+}
+
+std::size_t InstanceTable::referenceCount() const
+{
+    return m_references.size();
+}
+
+std::size_t InstanceTable::write(const ONX_Model &model, Json::Value &definitions, Json::Value &instances) const
+{
+    // Collect the extracted geometry and the nested references of each definition; the geometry of linked definitions is in other files
+    struct DefinitionData {
+        const ON_InstanceDefinition *idef;
+        Json::Value data;
+        std::vector<const InstanceReference *> nested;
+    };
+    std::vector<DefinitionData> idefs;
+    ONX_ModelComponentIterator it(model, ON_ModelComponent::Type::InstanceDefinition);
+    for (const ON_ModelComponent *component = it.FirstComponent(); component != nullptr; component = it.NextComponent())
+    {
+        const ON_InstanceDefinition *idef = ON_InstanceDefinition::Cast(component);
+        if (idef == nullptr || idef->IsLinkedType())
+            continue;
+        DefinitionData defData;
+        defData.idef = idef;
+        defData.data = Json::Value(Json::arrayValue);
+        const ON_SimpleArray<ON_UUID> &members = idef->InstanceGeometryIdList();
+        for (int m = 0; m < members.Count(); m++)
+        {
+            std::string memberId = uuidToString(members[m]);
+            auto geom = m_memberGeometry.find(memberId);
+            if (geom != m_memberGeometry.end())
+            {
+                // Surfaces of the breps are extracted as an array
+                if (geom->second.isArray())
+                {
+                    for (auto &d : geom->second)
+                        defData.data.append(d);
+                }
+                else if (!geom->second.empty())
+                    defData.data.append(geom->second);
+            }
+            auto ref = m_memberReferences.find(memberId);
+            if (ref != m_memberReferences.end())
+                defData.nested.push_back(&ref->second);
+        }
+        idefs.push_back(std::move(defData));
+    }
+
+    // A definition is empty unless it has extracted geometry or references a definition that is not empty (at any depth)
+    std::map<std::string, std::size_t> idefPosition;
+    for (std::size_t idx = 0; idx < idefs.size(); idx++)
+        idefPosition[uuidToString(idefs[idx].idef->Id())] = idx;
+    std::vector<bool> nonEmpty(idefs.size());
+    for (std::size_t idx = 0; idx < idefs.size(); idx++)
+        nonEmpty[idx] = !idefs[idx].data.empty();
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (std::size_t idx = 0; idx < idefs.size(); idx++)
+        {
+            if (nonEmpty[idx])
+                continue;
+            for (auto ref : idefs[idx].nested)
+            {
+                auto pos = idefPosition.find(ref->definition);
+                if (pos != idefPosition.end() && nonEmpty[pos->second])
+                {
+                    nonEmpty[idx] = true;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Assign an index to each definition that is not empty, in the order of the instance definition table
+    std::map<std::string, int> idefIndex;
+    int definitionCount = 0;
+    for (std::size_t idx = 0; idx < idefs.size(); idx++)
+    {
+        if (nonEmpty[idx])
+            idefIndex[uuidToString(idefs[idx].idef->Id())] = definitionCount++;
+    }
+
+    // Write the geometry and the nested references of each definition once
+    definitions = Json::Value(Json::arrayValue);
+    for (std::size_t idx = 0; idx < idefs.size(); idx++)
+    {
+        if (!nonEmpty[idx])
+            continue;
+        Json::Value def;
+        def["id"] = uuidToString(idefs[idx].idef->Id());
+        def["name"] = std::string(static_cast<const char *>(ON_String(idefs[idx].idef->Name())));
+        Json::Value nested(Json::arrayValue);
+        for (auto ref : idefs[idx].nested)
+        {
+            if (idefIndex.count(ref->definition) == 0)
+                continue;
+            Json::Value inst;
+            writeInstanceReference(*ref, idefIndex.at(ref->definition), inst);
+            nested.append(inst);
+        }
+        def["data"] = idefs[idx].data;
+        if (!nested.empty())
+            def["instances"] = nested;
+        definitions.append(def);
+    }
+
+    // References to linked, empty or missing definitions are dropped
+    instances = Json::Value(Json::arrayValue);
+    for (auto &reference : m_references)
+    {
+        if (idefIndex.count(reference.definition) == 0)
+            continue;
+        Json::Value inst;
+        writeInstanceReference(reference, idefIndex.at(reference.definition), inst);
+        instances.append(inst);
+    }
+    return instances.size();
+}
+
+void extractInstanceReference(const ON_InstanceRef *instanceRef, InstanceReference &reference)
+{
+    reference.definition = uuidToString(instanceRef->m_instance_definition_uuid);
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++)
+            reference.xform[r * 4 + c] = instanceRef->m_xform.m_xform[r][c];
+    }
+}
+
+void writeInstanceReference(const InstanceReference &reference, int definitionIndex, Json::Value &data)
+{
+    data["definition"] = definitionIndex;
+    Json::Value xform(Json::arrayValue);
+    for (int i = 0; i < 16; i++)
+        xform[i] = reference.xform[i];
+    data["xform"] = xform;
+}
+
+void constructInstanceReference(const Json::Value &data, const std::vector<ON_UUID> &definitionIds, ON_InstanceRef *&instanceRef)
+{
+    instanceRef = nullptr;
+    int definitionIndex = data["definition"].asInt();
+    if (definitionIndex < 0 || (std::size_t)definitionIndex >= definitionIds.size() || data["xform"].size() != 16)
+        return;
+
+    instanceRef = new ON_InstanceRef();
+    instanceRef->m_instance_definition_uuid = definitionIds[definitionIndex];
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++)
+            instanceRef->m_xform.m_xform[r][c] = data["xform"][r * 4 + c].asDouble();
+    }
+}
@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef INSTANCES_H
+#define INSTANCES_H
+
+#include "common.h"
+#include "rw3dm.h"
+
+// Block instance reference as a definition id and a row-major 4x4 transformation
+struct InstanceReference {
+    std::string definition;
+    double xform[16];
+};
+
+/** \brief Collects block instance definitions and references while reading a model.
+
+Geometry of the definitions is extracted once and stored by object id, so that
+each reference only costs a definition index and a transformation.
+*/
+class InstanceTable
+{
+public:
+    void addMemberGeometry(const std::string &, const Json::Value &);
+    void addMemberReference(const std::string &, const InstanceReference &);
+    void addReference(const InstanceReference &);
+    std::size_t referenceCount() const;
+
+    // Writes the definitions and the references to the JSON arrays; returns the number of references written
+    std::size_t write(const ONX_Model &, Json::Value &, Json::Value &) const;
+
+private:
+    std::map<std::string, Json::Value> m_memberGeometry;
+    std::map<std::string, InstanceReference> m_memberReferences;
+    std::vector<InstanceReference> m_references;
+};
+
+// Instance reference conversion
+void extractInstanceReference(const ON_InstanceRef *, InstanceReference &);
+void writeInstanceReference(const InstanceReference &, int, Json::Value &);
+void constructInstanceReference(const Json::Value &, const std::vector<ON_UUID> &, ON_InstanceRef *&);
+
+#endif /* INSTANCES_H */
@@ -0,0 +1,273 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mmap_archive.h"
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+    : m_data(nullptr), m_size(0)
+#if defined(_WIN32)
+    , m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &fileName)
+{
+    close();
+#if defined(_WIN32)
+    // Sequential scan hint lets the cache manager read ahead aggressively
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = (const unsigned char *)data;
+    m_size = (ON__UINT64)fileSize.QuadPart;
+#else
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing the file descriptor
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    // Archives are decoded front to back
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    m_data = (const unsigned char *)data;
+    m_size = (ON__UINT64)st.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data == nullptr)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    munmap((void *)m_data, (size_t)m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+
+MappedArchive::MappedArchive(const unsigned char *data, ON__UINT64 size)
+    : ON_BinaryArchive(ON::archive_mode::read3dm), m_data(data), m_size(size), m_pos(0)
+{
+}
+
+MappedArchive::~MappedArchive()
+{
+}
+
+bool MappedArchive::AtEnd() const
+{
+    return m_pos >= m_size;
+}
+
+bool MappedArchive::Flush()
+{
+    // Nothing to flush in a read-only archive
+    return true;
+}
+
+ON__UINT64 MappedArchive::Internal_CurrentPositionOverride() const
+{
+    return m_pos;
+}
+
+bool MappedArchive::Internal_SeekFromCurrentPositionOverride(int byteOffset)
+{
+    if (byteOffset < 0 && (ON__UINT64)(-(ON__INT64)byteOffset) > m_pos)
+        return false;
+    ON__UINT64 pos = (ON__UINT64)((ON__INT64)m_pos + byteOffset);
+    if (pos > m_size)
+        return false;
+    m_pos = pos;
+    return true;
+}
+
+bool MappedArchive::Internal_SeekToStartOverride()
+{
+    m_pos = 0;
+    return true;
+}
+
+size_t MappedArchive::Internal_ReadOverride(size_t count, void *buffer)
+{
+    // Read as much as possible, like fread()
+    ON__UINT64 remaining = m_size - m_pos;
+    if ((ON__UINT64)count > remaining)
+        count = (size_t)remaining;
+    if (count > 0)
+    {
+        std::memcpy(buffer, m_data + m_pos, count);
+        m_pos += count;
+    }
+    return count;
+}
+
+size_t MappedArchive::Internal_WriteOverride(size_t, const void *)
+{
+    // Mapped archives are read-only
+    return 0;
+}
+
+
+bool scanObjectTable(ON_BinaryArchive &archive, unsigned int objectFilter, std::vector<ObjectRecord> &records, ON__UINT64 &skippedBytes)
+{
+    // Read only chunk headers (typecode + length) and jump over the chunk contents
+    for (;;)
+    {
+        ON__UINT64 start = archive.CurrentPosition();
+        unsigned int tcode = 0;
+        ON__INT64 value = 0;
+        if (!archive.BeginRead3dmBigChunk(&tcode, &value))
+            return false;
+
+        // The record type is stored in the value of the first chunk inside the object record
+        unsigned int objectType = 0;
+        if (tcode == TCODE_OBJECT_RECORD)
+        {
+            unsigned int typeCode = 0;
+            ON__INT64 typeValue = 0;
+            if (archive.BeginRead3dmBigChunk(&typeCode, &typeValue))
+            {
+                if (typeCode == TCODE_OBJECT_RECORD_TYPE)
+                    objectType = (unsigned int)typeValue;
+                if (!archive.EndRead3dmChunk())
+                    return false;
+            }
+        }
+
+        if (!archive.EndRead3dmChunk())
+            return false;
+        ON__UINT64 end = archive.CurrentPosition();
+
+        if (tcode == TCODE_ENDOFTABLE)
+            break;
+        if (tcode != TCODE_OBJECT_RECORD)
+            continue;
+
+        if (objectType & objectFilter)
+            records.push_back({ start, end - start, objectType });
+        else
+            skippedBytes += end - start;
+    }
+    return true;
+}
+
+bool readObjectRecord(const unsigned char *data, const ObjectRecord &record, int archive3dmVersion, unsigned int archiveOpenNURBSVersion, bool skipUserData, ON_Object *&object, ON_3dmObjectAttributes *attributes)
+{
+    // Independent archive view over the object record; safe to use from any thread
+    ON_Read3dmBufferArchive view((size_t)record.length, data + record.offset, false, archive3dmVersion, archiveOpenNURBSVersion);
+    if (skipUserData)
+        view.SetShouldSerializeUserDataDefault(false);
+
+    object = nullptr;
+    unsigned int tcode = 0;
+    ON__INT64 value = 0;
+    if (!view.BeginRead3dmBigChunk(&tcode, &value))
+        return false;
+
+    bool rc = (tcode == TCODE_OBJECT_RECORD);
+
+    // Skip the record type chunk
+    if (rc && view.BeginRead3dmBigChunk(&tcode, &value))
+        rc = (tcode == TCODE_OBJECT_RECORD_TYPE) && view.EndRead3dmChunk();
+    else
+        rc = false;
+
+    // Read the object
+    if (rc)
+        rc = (view.ReadObject(&object) == 1 && object != nullptr);
+
+    // Read the object attributes (optional)
+    if (rc && attributes != nullptr && view.BeginRead3dmBigChunk(&tcode, &value))
+    {
+        if (tcode == TCODE_OBJECT_RECORD_ATTRIBUTES)
+            attributes->Read(view);
+        view.EndRead3dmChunk();
+    }
+
+    // Jump to the end of the object record
+    view.EndRead3dmChunk();
+
+    if (!rc && object != nullptr)
+    {
+        delete object;
+        object = nullptr;
+    }
+    return rc;
+}
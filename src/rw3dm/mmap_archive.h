@@ -0,0 +1,101 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MMAP_ARCHIVE_H
+#define MMAP_ARCHIVE_H
+
+#include "common.h"
+#include <opennurbs_public.h>
+
+
+/** \brief Read-only memory map of a file.
+*/
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string &);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; };
+    const unsigned char *data() const { return m_data; };
+    ON__UINT64 size() const { return m_size; };
+
+private:
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *m_data;
+    ON__UINT64 m_size;
+#if defined(_WIN32)
+    void *m_file;
+    void *m_mapping;
+#endif
+};
+
+
+/** \brief OpenNURBS archive reading directly from a memory-mapped buffer.
+
+Replaces ON_BinaryFile for reading; chunk reads become plain memory copies
+from the mapped pages instead of buffered fread() calls.
+*/
+class MappedArchive : public ON_BinaryArchive
+{
+public:
+    MappedArchive(const unsigned char *, ON__UINT64);
+    ~MappedArchive();
+
+    bool AtEnd() const override;
+    bool Flush() override;
+
+protected:
+    ON__UINT64 Internal_CurrentPositionOverride() const override;
+    bool Internal_SeekFromCurrentPositionOverride(int) override;
+    bool Internal_SeekToStartOverride() override;
+    size_t Internal_ReadOverride(size_t, void *) override;
+    size_t Internal_WriteOverride(size_t, const void *) override;
+
+private:
+    MappedArchive(const MappedArchive &) = delete;
+    MappedArchive &operator=(const MappedArchive &) = delete;
+
+    const unsigned char *m_data;
+    ON__UINT64 m_size;
+    ON__UINT64 m_pos;
+};
+
+
+// Location of an object record inside the object table
+struct ObjectRecord {
+    ON__UINT64 offset;
+    ON__UINT64 length;
+    unsigned int type;
+};
+
+// Object table scanning and random access decoding
+bool scanObjectTable(ON_BinaryArchive &, unsigned int, std::vector<ObjectRecord> &, ON__UINT64 &);
+bool readObjectRecord(const unsigned char *, const ObjectRecord &, int, unsigned int, bool, ON_Object *&, ON_3dmObjectAttributes *);
+
+#endif /* MMAP_ARCHIVE_H */
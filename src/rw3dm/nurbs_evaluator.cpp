@@ -0,0 +1,238 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "nurbs_evaluator.h"
+#include <algorithm>
+
+// Largest supported order (the basis function buffers are allocated on the stack)
+#define RW3DM_EVALUATOR_MAX_ORDER 16
+
+static const int blockSize = RW3DM_EVALUATOR_BLOCK_SIZE;
+
+
+// Knots of one parametric direction (OpenNURBS layout without the superfluous knots)
+struct KnotDirection {
+    const double *knots;
+    int order;
+    int cvCount;
+
+    // Finds the span index i with knots[i] <= t < knots[i + 1], trying the hint first
+    int findSpan(double t, int hint) const
+    {
+        const int first = order - 2;
+        const int last = cvCount - 2;
+        if (hint >= first && hint <= last)
+        {
+            if (knots[hint] <= t && (t < knots[hint + 1] || hint == last))
+                return hint;
+            if (hint < last && knots[hint + 1] <= t && (t < knots[hint + 2] || hint + 1 == last))
+                return hint + 1;
+        }
+        int span = (int)(std::upper_bound(knots + first, knots + last + 1, t) - knots) - 1;
+        return std::min(std::max(span, first), last);
+    }
+
+    // Computes the nonzero basis functions of the span for a block of parameters (basis[j * blockSize + lane])
+    void basisFunctions(int span, const double *t, int lanes, double *basis) const
+    {
+        const int degree = order - 1;
+        double left[RW3DM_EVALUATOR_MAX_ORDER * blockSize];
+        double right[RW3DM_EVALUATOR_MAX_ORDER * blockSize];
+        double saved[blockSize];
+
+        for (int l = 0; l < lanes; l++)
+            basis[l] = 1.0;
+        for (int j = 1; j <= degree; j++)
+        {
+            const double kl = knots[span + 1 - j];
+            const double kr = knots[span + j];
+            for (int l = 0; l < lanes; l++)
+            {
+                left[j * blockSize + l] = t[l] - kl;
+                right[j * blockSize + l] = kr - t[l];
+                saved[l] = 0.0;
+            }
+            for (int r = 0; r < j; r++)
+            {
+                double *nr = basis + r * blockSize;
+                const double *rr = right + (r + 1) * blockSize;
+                const double *lr = left + (j - r) * blockSize;
+                for (int l = 0; l < lanes; l++)
+                {
+                    const double temp = nr[l] / (rr[l] + lr[l]);
+                    nr[l] = saved[l] + rr[l] * temp;
+                    saved[l] = lr[l] * temp;
+                }
+            }
+            for (int l = 0; l < lanes; l++)
+                basis[j * blockSize + l] = saved[l];
+        }
+    }
+};
+
+// Converts the accumulated homogeneous coordinates of a block to Euclidean points
+static void storeBlock(const double *sum, int dimension, bool rational, int lanes, double *points)
+{
+    for (int l = 0; l < lanes; l++)
+    {
+        const double w = (rational) ? sum[dimension * blockSize + l] : 1.0;
+        for (int c = 0; c < dimension; c++)
+            points[l * dimension + c] = (rational) ? sum[c * blockSize + l] / w : sum[c * blockSize + l];
+    }
+}
+
+
+NurbsCurveEvaluator::NurbsCurveEvaluator(const ON_NurbsCurve &nurbsCurve) : m_curve(nurbsCurve)
+{
+}
+
+int NurbsCurveEvaluator::dimension() const
+{
+    return m_curve.Dimension();
+}
+
+void NurbsCurveEvaluator::evaluate(const double *params, std::size_t count, double *points) const
+{
+    const KnotDirection dir = { m_curve.m_knot, m_curve.Order(), m_curve.CVCount() };
+    const int dimension = m_curve.Dimension();
+    const bool rational = m_curve.IsRational();
+    const int cvSize = dimension + ((rational) ? 1 : 0);
+    if (dir.order > RW3DM_EVALUATOR_MAX_ORDER || dir.order < 2 || dir.cvCount < dir.order)
+    {
+        // Fall back to the OpenNURBS evaluator
+        for (std::size_t idx = 0; idx < count; idx++)
+        {
+            ON_3dPoint pt;
+            m_curve.EvPoint(params[idx], pt);
+            for (int c = 0; c < dimension && c < 3; c++)
+                points[idx * dimension + c] = pt[c];
+        }
+        return;
+    }
+
+    double basis[RW3DM_EVALUATOR_MAX_ORDER * blockSize];
+    std::vector<double> sum((cvSize) * blockSize);
+    int span = -1;
+    std::size_t idx = 0;
+    while (idx < count)
+    {
+        // Collect a block of consecutive parameters in the same span
+        span = dir.findSpan(params[idx], span);
+        int lanes = 1;
+        while (lanes < blockSize && idx + lanes < count && dir.findSpan(params[idx + lanes], span) == span)
+            lanes++;
+
+        dir.basisFunctions(span, params + idx, lanes, basis);
+
+        // Sum the weighted control vertices
+        std::fill(sum.begin(), sum.end(), 0.0);
+        const int firstCv = span - dir.order + 2;
+        for (int j = 0; j < dir.order; j++)
+        {
+            const double *cv = m_curve.CV(firstCv + j);
+            const double *nj = basis + j * blockSize;
+            for (int c = 0; c < cvSize; c++)
+            {
+                double *sc = &sum[c * blockSize];
+                for (int l = 0; l < lanes; l++)
+                    sc[l] += nj[l] * cv[c];
+            }
+        }
+        storeBlock(sum.data(), dimension, rational, lanes, points + idx * dimension);
+        idx += lanes;
+    }
+}
+
+
+NurbsSurfaceEvaluator::NurbsSurfaceEvaluator(const ON_NurbsSurface &nurbsSurface) : m_surface(nurbsSurface)
+{
+}
+
+int NurbsSurfaceEvaluator::dimension() const
+{
+    return m_surface.Dimension();
+}
+
+void NurbsSurfaceEvaluator::evaluate(const double *u, const double *v, std::size_t count, double *points) const
+{
+    const KnotDirection dirU = { m_surface.m_knot[0], m_surface.Order(0), m_surface.CVCount(0) };
+    const KnotDirection dirV = { m_surface.m_knot[1], m_surface.Order(1), m_surface.CVCount(1) };
+    const int dimension = m_surface.Dimension();
+    const bool rational = m_surface.IsRational();
+    const int cvSize = dimension + ((rational) ? 1 : 0);
+    if (dirU.order > RW3DM_EVALUATOR_MAX_ORDER || dirV.order > RW3DM_EVALUATOR_MAX_ORDER || dirU.order < 2 || dirV.order < 2
+        || dirU.cvCount < dirU.order || dirV.cvCount < dirV.order)
+    {
+        // Fall back to the OpenNURBS evaluator
+        for (std::size_t idx = 0; idx < count; idx++)
+        {
+            ON_3dPoint pt;
+            m_surface.EvPoint(u[idx], v[idx], pt);
+            for (int c = 0; c < dimension && c < 3; c++)
+                points[idx * dimension + c] = pt[c];
+        }
+        return;
+    }
+
+    double basisU[RW3DM_EVALUATOR_MAX_ORDER * blockSize];
+    double basisV[RW3DM_EVALUATOR_MAX_ORDER * blockSize];
+    double coeff[blockSize];
+    std::vector<double> sum(cvSize * blockSize);
+    int spanU = -1, spanV = -1;
+    std::size_t idx = 0;
+    while (idx < count)
+    {
+        // Collect a block of consecutive parameters in the same span pair
+        spanU = dirU.findSpan(u[idx], spanU);
+        spanV = dirV.findSpan(v[idx], spanV);
+        int lanes = 1;
+        while (lanes < blockSize && idx + lanes < count
+            && dirU.findSpan(u[idx + lanes], spanU) == spanU && dirV.findSpan(v[idx + lanes], spanV) == spanV)
+            lanes++;
+
+        dirU.basisFunctions(spanU, u + idx, lanes, basisU);
+        dirV.basisFunctions(spanV, v + idx, lanes, basisV);
+
+        // Sum the weighted control vertices
+        std::fill(sum.begin(), sum.end(), 0.0);
+        const int firstU = spanU - dirU.order + 2;
+        const int firstV = spanV - dirV.order + 2;
+        for (int i = 0; i < dirU.order; i++)
+        {
+            for (int j = 0; j < dirV.order; j++)
+            {
+                const double *cv = m_surface.CV(firstU + i, firstV + j);
+                for (int l = 0; l < lanes; l++)
+                    coeff[l] = basisU[i * blockSize + l] * basisV[j * blockSize + l];
+                for (int c = 0; c < cvSize; c++)
+                {
+                    double *sc = &sum[c * blockSize];
+                    for (int l = 0; l < lanes; l++)
+                        sc[l] += coeff[l] * cv[c];
+                }
+            }
+        }
+        storeBlock(sum.data(), dimension, rational, lanes, points + idx * dimension);
+        idx += lanes;
+    }
+}
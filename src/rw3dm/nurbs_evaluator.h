@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef NURBS_EVALUATOR_H
+#define NURBS_EVALUATOR_H
+
+#include "common.h"
+#include <opennurbs_public.h>
+
+#ifndef RW3DM_EVALUATOR_BLOCK_SIZE
+#define RW3DM_EVALUATOR_BLOCK_SIZE 8
+#endif
+
+/** \brief Evaluates a NURBS curve at many parameters at once.
+
+The knot span of the previous parameter is tried first, so monotone parameter
+sequences find their spans without a search. Consecutive parameters in the same
+span are evaluated as a block, with the basis functions of all parameters
+computed together in structure-of-arrays form.
+*/
+class NurbsCurveEvaluator
+{
+public:
+    NurbsCurveEvaluator(const ON_NurbsCurve &);
+
+    // Evaluates the points at the parameters (each point has the dimension of the curve)
+    void evaluate(const double *, std::size_t, double *) const;
+
+    int dimension() const;
+
+private:
+    const ON_NurbsCurve &m_curve;
+};
+
+/** \brief Evaluates a NURBS surface at many (u, v) parameters at once.
+*/
+class NurbsSurfaceEvaluator
+{
+public:
+    NurbsSurfaceEvaluator(const ON_NurbsSurface &);
+
+    // Evaluates the points at the parameters (u and v arrays; each point has the dimension of the surface)
+    void evaluate(const double *, const double *, std::size_t, double *) const;
+
+    int dimension() const;
+
+private:
+    const ON_NurbsSurface &m_surface;
+};
+
+#endif /* NURBS_EVALUATOR_H */
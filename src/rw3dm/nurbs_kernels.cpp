@@ -0,0 +1,295 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "nurbs_kernels.h"
+#include <algorithm>
+#include <cstring>
+
+// SIMD kernels are compiled for x86-64 and selected at runtime (SSE2 is part of the x86-64 baseline)
+#if defined(RW3DM_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define RW3DM_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define RW3DM_TARGET_AVX
+#else
+#define RW3DM_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+// Converts a row of control vertices (arguments: cv, count, stride, dimension, points, weights, offset, length)
+typedef void (*RowKernel)(const double *, int, int, int, double *, double *, const double *, const double *);
+
+
+// Converts the control vertices of a row; the spatial dimension is fixed at compile time unless Dim is 0
+template <int Dim, bool Rational, bool Normalize>
+static void dehomogenizeRow(const double *cv, int count, int stride, int dimension, double *points, double *weights, const double *offset, const double *length)
+{
+    const int dim = (Dim > 0) ? Dim : dimension;
+    for (int idx = 0; idx < count; idx++, cv += stride, points += dim)
+    {
+        const double w = (Rational) ? cv[dim] : 1.0;
+        for (int c = 0; c < dim; c++)
+        {
+            const double cp = (Rational) ? cv[c] / w : cv[c];
+            points[c] = (Normalize) ? (cp - offset[c]) / length[c] : cp;
+        }
+        weights[idx] = w;
+    }
+}
+
+// Copies the control vertices of a non-rational row
+static void copyRow(const double *cv, int count, int stride, int dimension, double *points, double *weights, const double *offset, const double *length)
+{
+    if (stride == dimension)
+    {
+        std::memcpy(points, cv, sizeof(double) * count * dimension);
+        std::fill(weights, weights + count, 1.0);
+    }
+    else
+        dehomogenizeRow<0, false, false>(cv, count, stride, dimension, points, weights, offset, length);
+}
+
+template <int Dim>
+static RowKernel scalarRowKernel(bool rational, bool normalize)
+{
+    if (rational)
+        return (normalize) ? dehomogenizeRow<Dim, true, true> : dehomogenizeRow<Dim, true, false>;
+    return (normalize) ? dehomogenizeRow<Dim, false, true> : copyRow;
+}
+
+#ifdef RW3DM_SIMD_X86
+// Checks if the CPU and the operating system support AVX
+static bool cpuSupportsAvx()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+static bool useAvx()
+{
+    static const bool supported = cpuSupportsAvx();
+    return supported;
+}
+
+// SSE2: 2-dimensional control vertices (trim curves)
+template <bool Rational, bool Normalize>
+static void dehomogenizeRow2Sse2(const double *cv, int count, int stride, int dimension, double *points, double *weights, const double *offset, const double *length)
+{
+    const __m128d off = (Normalize) ? _mm_loadu_pd(offset) : _mm_setzero_pd();
+    const __m128d len = (Normalize) ? _mm_loadu_pd(length) : _mm_set1_pd(1.0);
+    for (int idx = 0; idx < count; idx++, cv += stride, points += 2)
+    {
+        const double w = (Rational) ? cv[2] : 1.0;
+        __m128d p = _mm_loadu_pd(cv);
+        if (Rational)
+            p = _mm_div_pd(p, _mm_set1_pd(w));
+        if (Normalize)
+            p = _mm_div_pd(_mm_sub_pd(p, off), len);
+        _mm_storeu_pd(points, p);
+        weights[idx] = w;
+    }
+}
+
+// SSE2: rational 3-dimensional control vertices (x and y are divided together)
+template <bool Normalize>
+static void dehomogenizeRow3Sse2(const double *cv, int count, int stride, int dimension, double *points, double *weights, const double *offset, const double *length)
+{
+    const __m128d off = (Normalize) ? _mm_loadu_pd(offset) : _mm_setzero_pd();
+    const __m128d len = (Normalize) ? _mm_loadu_pd(length) : _mm_set1_pd(1.0);
+    for (int idx = 0; idx < count; idx++, cv += stride, points += 3)
+    {
+        const double w = cv[3];
+        __m128d p = _mm_div_pd(_mm_loadu_pd(cv), _mm_set1_pd(w));
+        double z = cv[2] / w;
+        if (Normalize)
+        {
+            p = _mm_div_pd(_mm_sub_pd(p, off), len);
+            z = (z - offset[2]) / length[2];
+        }
+        _mm_storeu_pd(points, p);
+        points[2] = z;
+        weights[idx] = w;
+    }
+}
+
+// AVX: rational 3-dimensional control vertices (x, y, z and w are loaded together)
+template <bool Normalize>
+static RW3DM_TARGET_AVX void dehomogenizeRow3Avx(const double *cv, int count, int stride, int dimension, double *points, double *weights, const double *offset, const double *length)
+{
+    const __m256d off = (Normalize) ? _mm256_set_pd(0.0, offset[2], offset[1], offset[0]) : _mm256_setzero_pd();
+    const __m256d len = (Normalize) ? _mm256_set_pd(1.0, length[2], length[1], length[0]) : _mm256_set1_pd(1.0);
+    const int last = count - 1;
+    for (int idx = 0; idx < last; idx++, cv += stride, points += 3)
+    {
+        __m256d p = _mm256_div_pd(_mm256_loadu_pd(cv), _mm256_broadcast_sd(cv + 3));
+        if (Normalize)
+            p = _mm256_div_pd(_mm256_sub_pd(p, off), len);
+        // The fourth lane is overwritten by the next point
+        _mm256_storeu_pd(points, p);
+        weights[idx] = cv[3];
+    }
+
+    // The last point would write past the end of the row
+    if (count > 0)
+        dehomogenizeRow<3, true, Normalize>(cv, 1, stride, 3, points, weights + last, offset, length);
+}
+
+static RW3DM_TARGET_AVX void normalizeKnotsAvx(const double *knots, std::size_t count, double d0, double d1, double *result)
+{
+    const __m256d vd0 = _mm256_set1_pd(d0);
+    const __m256d vlen = _mm256_set1_pd(d1 - d0);
+    std::size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4)
+        _mm256_storeu_pd(result + idx, _mm256_div_pd(_mm256_sub_pd(_mm256_loadu_pd(knots + idx), vd0), vlen));
+    for (; idx < count; idx++)
+        result[idx] = (knots[idx] - d0) / (d1 - d0);
+}
+
+static void normalizeKnotsSse2(const double *knots, std::size_t count, double d0, double d1, double *result)
+{
+    const __m128d vd0 = _mm_set1_pd(d0);
+    const __m128d vlen = _mm_set1_pd(d1 - d0);
+    std::size_t idx = 0;
+    for (; idx + 2 <= count; idx += 2)
+        _mm_storeu_pd(result + idx, _mm_div_pd(_mm_sub_pd(_mm_loadu_pd(knots + idx), vd0), vlen));
+    for (; idx < count; idx++)
+        result[idx] = (knots[idx] - d0) / (d1 - d0);
+}
+#endif
+
+// Selects the row kernel once per object
+static RowKernel selectRowKernel(const CvArray &cvs, bool normalize)
+{
+#ifdef RW3DM_SIMD_X86
+    if (cvs.dimension == 2 && (cvs.rational || normalize))
+    {
+        if (cvs.rational)
+            return (normalize) ? dehomogenizeRow2Sse2<true, true> : dehomogenizeRow2Sse2<true, false>;
+        return dehomogenizeRow2Sse2<false, true>;
+    }
+    if (cvs.dimension == 3 && cvs.rational)
+    {
+        if (useAvx())
+            return (normalize) ? dehomogenizeRow3Avx<true> : dehomogenizeRow3Avx<false>;
+        return (normalize) ? dehomogenizeRow3Sse2<true> : dehomogenizeRow3Sse2<false>;
+    }
+#endif
+
+    // Trim curves are 2-dimensional, curves and surfaces are 3-dimensional
+    switch (cvs.dimension)
+    {
+    case 2:
+        return scalarRowKernel<2>(cvs.rational, normalize);
+    case 3:
+        return scalarRowKernel<3>(cvs.rational, normalize);
+    default:
+        return scalarRowKernel<0>(cvs.rational, normalize);
+    }
+}
+
+CvArray curveCvArray(const ON_NurbsCurve &nurbsCurve)
+{
+    CvArray cvs;
+    cvs.cv = nurbsCurve.m_cv;
+    cvs.dimension = nurbsCurve.Dimension();
+    cvs.rational = nurbsCurve.IsRational();
+    cvs.columns = nurbsCurve.CVCount();
+    cvs.columnStride = nurbsCurve.m_cv_stride;
+    return cvs;
+}
+
+CvArray surfaceCvArray(const ON_NurbsSurface &nurbsSurface)
+{
+    CvArray cvs;
+    cvs.cv = nurbsSurface.m_cv;
+    cvs.dimension = nurbsSurface.Dimension();
+    cvs.rational = nurbsSurface.IsRational();
+    cvs.rows = nurbsSurface.CVCount(0);
+    cvs.rowStride = nurbsSurface.m_cv_stride[0];
+    cvs.columns = nurbsSurface.CVCount(1);
+    cvs.columnStride = nurbsSurface.m_cv_stride[1];
+    return cvs;
+}
+
+void dehomogenizeControlPoints(const CvArray &cvs, double *points, double *weights, const double *offset, const double *length)
+{
+    if (cvs.cv == nullptr)
+        return;
+
+    RowKernel kernel = selectRowKernel(cvs, offset != nullptr && length != nullptr);
+    for (int row = 0; row < cvs.rows; row++)
+    {
+        std::size_t first = (std::size_t)row * cvs.columns;
+        kernel(cvs.cv + (std::size_t)row * cvs.rowStride, cvs.columns, cvs.columnStride, cvs.dimension, points + first * cvs.dimension, weights + first, offset, length);
+    }
+}
+
+void curveKnotVector(const ON_NurbsCurve &nurbsCurve, std::vector<double> &knots)
+{
+    int count = nurbsCurve.KnotCount();
+    knots.resize(count + 2);
+    knots[0] = nurbsCurve.SuperfluousKnot(false);
+    std::memcpy(&knots[1], nurbsCurve.m_knot, sizeof(double) * count);
+    knots[count + 1] = nurbsCurve.SuperfluousKnot(true);
+}
+
+void surfaceKnotVector(const ON_NurbsSurface &nurbsSurface, int dir, std::vector<double> &knots)
+{
+    int count = nurbsSurface.KnotCount(dir);
+    knots.resize(count + 2);
+    knots[0] = nurbsSurface.SuperfluousKnot(dir, false);
+    std::memcpy(&knots[1], nurbsSurface.m_knot[dir], sizeof(double) * count);
+    knots[count + 1] = nurbsSurface.SuperfluousKnot(dir, true);
+}
+
+void normalizeKnots(const double *knots, std::size_t count, const ON_Interval &domain, double *result)
+{
+    const double d0 = domain.m_t[0];
+    const double d1 = domain.m_t[1];
+#ifdef RW3DM_SIMD_X86
+    if (useAvx())
+        normalizeKnotsAvx(knots, count, d0, d1, result);
+    else
+        normalizeKnotsSse2(knots, count, d0, d1, result);
+#else
+    for (std::size_t idx = 0; idx < count; idx++)
+        result[idx] = (knots[idx] - d0) / (d1 - d0);
+#endif
+}
+
+const char *kernelInstructionSet()
+{
+#ifdef RW3DM_SIMD_X86
+    return (useAvx()) ? "avx" : "sse2";
+#else
+    return "scalar";
+#endif
+}
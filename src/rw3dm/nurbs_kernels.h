@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef NURBS_KERNELS_H
+#define NURBS_KERNELS_H
+
+#include "common.h"
+#include <opennurbs_public.h>
+
+/** \brief Row-major grid of homogeneous OpenNURBS control vertices.
+
+Curves have a single row. Each vertex stores the weighted coordinates (Pw),
+followed by the weight if the geometry is rational. With RW3DM_SIMD on x86-64,
+the conversion uses SSE2 or AVX kernels selected at runtime; the results are
+identical to the scalar kernels.
+*/
+struct CvArray {
+    const double *cv = nullptr;
+    int dimension = 0;
+    bool rational = false;
+    int rows = 1;
+    int rowStride = 0;
+    int columns = 0;
+    int columnStride = 0;
+};
+
+// Control vertex arrays of NURBS curves and surfaces
+CvArray curveCvArray(const ON_NurbsCurve &);
+CvArray surfaceCvArray(const ON_NurbsSurface &);
+
+// Converts the control vertices to Euclidean points and weights; the points are mapped with (p - offset) / length if both are given
+void dehomogenizeControlPoints(const CvArray &, double *, double *, const double * = nullptr, const double * = nullptr);
+
+// Knot vectors including the superfluous knots
+void curveKnotVector(const ON_NurbsCurve &, std::vector<double> &);
+void surfaceKnotVector(const ON_NurbsSurface &, int, std::vector<double> &);
+
+// Maps the knots to [0, 1] w.r.t. the domain
+void normalizeKnots(const double *, std::size_t, const ON_Interval &, double *);
+
+// Instruction set of the selected kernels ("avx", "sse2" or "scalar")
+const char *kernelInstructionSet();
+
+#endif /* NURBS_KERNELS_H */
@@ -0,0 +1,225 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "object_index.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+std::string objectIndexFileName(const std::string &fileName)
+{
+    return fileName + ".idx.json";
+}
+
+bool fileSignature(const std::string &fileName, ON__UINT64 &fileSize, ON__INT64 &fileTime)
+{
+#if defined(_WIN32)
+    struct _stat64 st;
+    if (_stat64(fileName.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0)
+        return false;
+#endif
+    fileSize = (ON__UINT64)st.st_size;
+    fileTime = (ON__INT64)st.st_mtime;
+    return true;
+}
+
+bool buildObjectIndex(ON_BinaryArchive &archive, const unsigned char *data, unsigned int threads, bool skipUserData, ObjectIndex &index)
+{
+    // Find all object records; the archive should be positioned at the object table
+    std::vector<ObjectRecord> records;
+    ON__UINT64 skippedBytes = 0;
+    if (!archive.BeginRead3dmObjectTable() || !scanObjectTable(archive, ON::any_object, records, skippedBytes) || !archive.EndRead3dmObjectTable())
+        return false;
+
+    index.archive3dmVersion = archive.Archive3dmVersion();
+    index.archiveOpenNURBSVersion = archive.ArchiveOpenNURBSVersion();
+    index.entries.resize(records.size());
+
+    // Decode each object once to find its id, attributes and bounding box
+    parallelFor(records.size(), threads, [&](std::size_t idx) {
+        IndexEntry &entry = index.entries[idx];
+        entry.record = records[idx];
+        entry.layer = -1;
+        entry.visible = true;
+        entry.hasBox = false;
+
+        ON_Object *object = nullptr;
+        ON_3dmObjectAttributes attributes;
+        if (!readObjectRecord(data, records[idx], index.archive3dmVersion, index.archiveOpenNURBSVersion, skipUserData, object, &attributes))
+            return;
+
+        entry.id = uuidToString(attributes.m_uuid);
+        entry.layer = attributes.m_layer_index;
+        entry.name = toUtf8Lower(attributes.m_name);
+        entry.visible = attributes.IsVisible();
+        const ON_Geometry *geometry = ON_Geometry::Cast(object);
+        if (geometry != nullptr)
+        {
+            ON_BoundingBox bbox = geometry->BoundingBox();
+            if (bbox.IsValid())
+            {
+                entry.hasBox = true;
+                for (int c = 0; c < 3; c++)
+                {
+                    entry.box[c] = bbox.m_min[c];
+                    entry.box[c + 3] = bbox.m_max[c];
+                }
+            }
+        }
+        delete object;
+    });
+    return true;
+}
+
+bool saveObjectIndex(const std::string &fileName, const ObjectIndex &index)
+{
+    Json::Value root;
+    root["version"] = RW3DM_INDEX_VERSION;
+    root["file_size"] = (Json::UInt64)index.fileSize;
+    root["file_time"] = (Json::Int64)index.fileTime;
+    root["archive_3dm_version"] = index.archive3dmVersion;
+    root["archive_opennurbs_version"] = index.archiveOpenNURBSVersion;
+
+    Json::Value layers(Json::arrayValue);
+    for (auto &layer : index.layers)
+    {
+        Json::Value lyr;
+        lyr["name"] = layer.name;
+        lyr["visible"] = layer.visible;
+        layers.append(lyr);
+    }
+    root["layers"] = layers;
+
+    Json::Value objects(Json::arrayValue);
+    objects.resize((Json::ArrayIndex)index.entries.size());
+    for (std::size_t idx = 0; idx < index.entries.size(); idx++)
+    {
+        const IndexEntry &entry = index.entries[idx];
+        Json::Value obj;
+        obj["id"] = entry.id;
+        obj["type"] = entry.record.type;
+        obj["layer"] = entry.layer;
+        if (!entry.name.empty())
+            obj["name"] = entry.name;
+        if (!entry.visible)
+            obj["visible"] = false;
+        obj["offset"] = (Json::UInt64)entry.record.offset;
+        obj["length"] = (Json::UInt64)entry.record.length;
+        if (entry.hasBox)
+        {
+            Json::Value box(Json::arrayValue);
+            for (int c = 0; c < 6; c++)
+                box[c] = entry.box[c];
+            obj["bbox"] = box;
+        }
+        objects[(Json::ArrayIndex)idx] = obj;
+    }
+    root["objects"] = objects;
+
+    std::ofstream fp(fileName.c_str(), std::ios::out);
+    if (!fp)
+        return false;
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    fp << Json::writeString(wbuilder, root) << std::endl;
+    return fp.good();
+}
+
+bool loadObjectIndex(const std::string &fileName, ObjectIndex &index)
+{
+    std::ifstream fp(fileName.c_str(), std::ios::in);
+    if (!fp)
+        return false;
+
+    Json::Value root;
+    Json::CharReaderBuilder rbuilder;
+    std::string jsonErrors;
+    if (!Json::parseFromStream(rbuilder, fp, &root, &jsonErrors))
+        return false;
+    if (root["version"].asInt() != RW3DM_INDEX_VERSION)
+        return false;
+
+    index.fileSize = root["file_size"].asUInt64();
+    index.fileTime = root["file_time"].asInt64();
+    index.archive3dmVersion = root["archive_3dm_version"].asInt();
+    index.archiveOpenNURBSVersion = root["archive_opennurbs_version"].asUInt();
+
+    const Json::Value &layers = root["layers"];
+    index.layers.clear();
+    for (auto &lyr : layers)
+        index.layers.push_back({ lyr["name"].asString(), lyr["visible"].asBool() });
+
+    const Json::Value &objects = root["objects"];
+    index.entries.resize(objects.size());
+    for (Json::ArrayIndex idx = 0; idx < objects.size(); idx++)
+    {
+        const Json::Value &obj = objects[idx];
+        IndexEntry &entry = index.entries[idx];
+        entry.id = obj["id"].asString();
+        entry.record.type = obj["type"].asUInt();
+        entry.record.offset = obj["offset"].asUInt64();
+        entry.record.length = obj["length"].asUInt64();
+        entry.layer = obj["layer"].asInt();
+        entry.name = obj.get("name", "").asString();
+        entry.visible = obj.get("visible", true).asBool();
+        entry.hasBox = obj.isMember("bbox");
+        for (int c = 0; c < 6 && entry.hasBox; c++)
+            entry.box[c] = obj["bbox"][c].asDouble();
+    }
+    return true;
+}
+
+// Read a little-endian unsigned integer of the chunk headers
+static ON__UINT64 readHeaderValue(const unsigned char *data, int numBytes)
+{
+    ON__UINT64 value = 0;
+    for (int idx = numBytes - 1; idx >= 0; idx--)
+        value = (value << 8) | data[idx];
+    return value;
+}
+
+bool validateObjectIndex(const ObjectIndex &index, const unsigned char *data, ON__UINT64 size)
+{
+    // The modification time has a resolution of a second, so the entries are checked against the chunk headers before any decoding
+    int lengthSize = (index.archive3dmVersion >= 50) ? 8 : 4;
+    ON__UINT64 headerSize = 2 * (4 + lengthSize);
+    for (auto &entry : index.entries)
+    {
+        const ObjectRecord &record = entry.record;
+        if (record.offset > size || record.length > size - record.offset || record.length < headerSize)
+            return false;
+
+        // Object record chunk spanning the whole entry, starting with the record type chunk of the entry type
+        const unsigned char *header = data + record.offset;
+        if (readHeaderValue(header, 4) != TCODE_OBJECT_RECORD || readHeaderValue(header + 4, lengthSize) != record.length - 4 - lengthSize)
+            return false;
+        header += 4 + lengthSize;
+        if (readHeaderValue(header, 4) != TCODE_OBJECT_RECORD_TYPE || readHeaderValue(header + 4, lengthSize) != record.type)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef OBJECT_INDEX_H
+#define OBJECT_INDEX_H
+
+#include "common.h"
+#include "mmap_archive.h"
+#include "rw3dm.h"
+#include <json/json.h>
+
+#ifndef RW3DM_INDEX_VERSION
+#define RW3DM_INDEX_VERSION 2
+#endif
+
+// Index entry of a single object record
+struct IndexEntry {
+    ObjectRecord record;
+    std::string id;
+    int layer;
+    std::string name;
+    bool visible;
+    bool hasBox;
+    double box[6];
+};
+
+// Sidecar index mapping objects to their archive byte ranges
+struct ObjectIndex {
+    ON__UINT64 fileSize;
+    ON__INT64 fileTime;
+    int archive3dmVersion;
+    unsigned int archiveOpenNURBSVersion;
+    std::vector<LayerInfo> layers;
+    std::vector<IndexEntry> entries;
+};
+
+// Index file operations
+std::string objectIndexFileName(const std::string &);
+bool fileSignature(const std::string &, ON__UINT64 &, ON__INT64 &);
+bool buildObjectIndex(ON_BinaryArchive &, const unsigned char *, unsigned int, bool, ObjectIndex &);
+bool saveObjectIndex(const std::string &, const ObjectIndex &);
+bool loadObjectIndex(const std::string &, ObjectIndex &);
+bool validateObjectIndex(const ObjectIndex &, const unsigned char *, ON__UINT64);
+
+#endif /* OBJECT_INDEX_H */
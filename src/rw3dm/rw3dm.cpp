@@ -22,6 +22,7 @@ SOFTWARE.
 */
 
 #include "rw3dm.h"
+#include "surface_cache.h"
 
 
 void initializeRwExt()
@@ -34,204 +35,249 @@ void finalizeRwExt()
     ON::End();
 }
 
-void extractNurbsCurveData(const ON_Geometry* geometry, Config &cfg, Json::Value &data, double *paramOffset, double *paramLength)
+// Write a knot vector including the superfluous knots, optionally normalized to [0, 1]
+static void writeKnotVector(const char *key, const std::vector<double> &knots, const ON_Interval &domain, bool normalize, GeometrySink &sink)
 {
-    // We expect a curve object
-    if (ON::object_type::curve_object != geometry->ObjectType())
-        return;
-
-    // We know that "geometry" is a curve object
-    const ON_Curve *curve = (ON_Curve *)geometry;
-
-    // Try to get the NURBS form of the curve object
-    ON_NurbsCurve nurbsCurve;
-    if (curve->NurbsCurve(&nurbsCurve))
+    if (!normalize)
     {
-        // Get dimension
-        data["dimension"] = nurbsCurve.Dimension();
-
-        // Get rational
-        data["rational"] = nurbsCurve.IsRational();
-
-        // Get degree
-        data["degree"] = nurbsCurve.Degree();
-
-        // Get knot vector
-        Json::Value knotVector;
-        if (cfg.normalize())
-        {
-            // Get parametric domain
-            double *d = nurbsCurve.Domain().m_t;
-
-            // Normalize knot vector
-            knotVector.append((nurbsCurve.SuperfluousKnot(false) - d[0]) / (d[1] - d[0]));
-            for (int idx = 0; idx < nurbsCurve.KnotCount(); idx++)
-                knotVector[idx + 1] = (nurbsCurve.Knot(idx) - d[0]) / (d[1] - d[0]);
-            knotVector.append((nurbsCurve.SuperfluousKnot(true) - d[0]) / (d[1] - d[0]));
-        }
-        else
-        {
-            knotVector.append(nurbsCurve.SuperfluousKnot(false));
-            for (int idx = 0; idx < nurbsCurve.KnotCount(); idx++)
-                knotVector[idx + 1] = nurbsCurve.Knot(idx);
-            knotVector.append(nurbsCurve.SuperfluousKnot(true));
-        }
-        data["knotvector"] = knotVector;
+        sink.writeDoubleArray(key, knots.data(), knots.size());
+        return;
+    }
 
-        Json::Value controlPoints;
-        Json::Value points;
-        Json::Value weights;
+    // Normalize knot vector
+    std::vector<double> knotsNormalized(knots.size());
+    normalizeKnots(knots.data(), knots.size(), domain, knotsNormalized.data());
+    sink.writeDoubleArray(key, knotsNormalized.data(), knotsNormalized.size());
+}
 
-        // Get control points and weights
-        for (int idx = 0; idx < nurbsCurve.CVCount(); idx++)
-        {
-            double *vertex = nurbsCurve.CV(idx);
-            double weight = nurbsCurve.Weight(idx);
-            Json::Value point;
-            for (int c = 0; c < nurbsCurve.Dimension(); c++)
-            {
-                double cp = vertex[c] / weight;
-                if (paramOffset != nullptr && paramLength != nullptr && cfg.normalize())
-                    point[c] = (cp - paramOffset[c]) / paramLength[c];
-                else
-                    point[c] = cp;
-            }
-            points[idx] = point;
-            weights[idx] = weight;
-        }
-        controlPoints["points"] = points;
-        controlPoints["weights"] = weights;
+// Write the members of a NURBS curve object
+static void writeNurbsCurveMembers(const ON_NurbsCurve &nurbsCurve, Config &cfg, GeometrySink &sink, double *paramOffset, double *paramLength)
+{
+    // Get dimension
+    sink.writeInt("dimension", nurbsCurve.Dimension());
 
-        data["control_points"] = controlPoints;
-    }
+    // Get rational
+    sink.writeBool("rational", nurbsCurve.IsRational());
+
+    // Get degree
+    sink.writeInt("degree", nurbsCurve.Degree());
+
+    // Get knot vector
+    std::vector<double> knotVector;
+    curveKnotVector(nurbsCurve, knotVector);
+    writeKnotVector("knotvector", knotVector, nurbsCurve.Domain(), cfg.normalize(), sink);
+
+    // Get control points and weights (trim curves are mapped to the normalized surface domain)
+    int dimension = nurbsCurve.Dimension();
+    std::vector<double> points(nurbsCurve.CVCount() * dimension);
+    std::vector<double> weights(nurbsCurve.CVCount());
+    bool normalizePoints = (paramOffset != nullptr && paramLength != nullptr && cfg.normalize());
+    dehomogenizeControlPoints(curveCvArray(nurbsCurve), points.data(), weights.data(),
+        (normalizePoints) ? paramOffset : nullptr, (normalizePoints) ? paramLength : nullptr);
+    writeControlPoints(points, weights, dimension, nurbsCurve.IsRational(), cfg, sink, "control_points");
 }
 
-void extractNurbsSurfaceData(const ON_NurbsSurface* nurbsSurface, Config& cfg, Json::Value& data) {
+// Write the members of a NURBS surface object
+static void writeNurbsSurfaceMembers(const ON_NurbsSurface *nurbsSurface, Config &cfg, GeometrySink &sink)
+{
     // Get dimension
-    data["dimension"] = nurbsSurface->Dimension();
+    sink.writeInt("dimension", nurbsSurface->Dimension());
 
     // Get rational
-    data["rational"] = nurbsSurface->IsRational();
+    sink.writeBool("rational", nurbsSurface->IsRational());
 
     // Get degrees
-    data["degree_u"] = nurbsSurface->Degree(0);
-    data["degree_v"] = nurbsSurface->Degree(1);
+    sink.writeInt("degree_u", nurbsSurface->Degree(0));
+    sink.writeInt("degree_v", nurbsSurface->Degree(1));
 
     // Get knot vectors
-    Json::Value knotVectorU;
-    if (cfg.normalize())
-    {
-        // Get parametric domain
-        double* dU = nurbsSurface->Domain(0).m_t;
-
-        // Normalize knot vector
-        knotVectorU.append((nurbsSurface->SuperfluousKnot(0, false) - dU[0]) / (dU[1] - dU[0]));
-        for (int idx = 0; idx < nurbsSurface->KnotCount(0); idx++)
-            knotVectorU[idx + 1] = (nurbsSurface->Knot(0, idx) - dU[0]) / (dU[1] - dU[0]);
-        knotVectorU.append((nurbsSurface->SuperfluousKnot(0, true) - dU[0]) / (dU[1] - dU[0]));
-    }
-    else
+    const char *knotKeys[2] = { "knotvector_u", "knotvector_v" };
+    for (int dir = 0; dir < 2; dir++)
     {
-        knotVectorU.append(nurbsSurface->SuperfluousKnot(0, false));
-        for (int idx = 0; idx < nurbsSurface->KnotCount(0); idx++)
-            knotVectorU[idx + 1] = nurbsSurface->Knot(0, idx);
-        knotVectorU.append(nurbsSurface->SuperfluousKnot(0, true));
+        std::vector<double> knotVector;
+        surfaceKnotVector(*nurbsSurface, dir, knotVector);
+        writeKnotVector(knotKeys[dir], knotVector, nurbsSurface->Domain(dir), cfg.normalize(), sink);
     }
-    data["knotvector_u"] = knotVectorU;
 
-    Json::Value knotVectorV;
-    if (cfg.normalize())
+    // Get control points and weights
+    int dimension = nurbsSurface->Dimension();
+    int sizeU = nurbsSurface->CVCount(0);
+    int sizeV = nurbsSurface->CVCount(1);
+    std::vector<double> points(sizeU * sizeV * dimension);
+    std::vector<double> weights(sizeU * sizeV);
+    dehomogenizeControlPoints(surfaceCvArray(*nurbsSurface), points.data(), weights.data());
+
+    sink.writeInt("size_u", sizeU);
+    sink.writeInt("size_v", sizeV);
+    writeControlPoints(points, weights, dimension, nurbsSurface->IsRational(), cfg, sink, "control_points");
+}
+
+// Convert a surface to its NURBS form (or reuse an identical one); returns nullptr if the conversion fails
+static std::shared_ptr<const ON_NurbsSurface> convertSurface(const ON_Surface *surface, SurfaceCache *cache)
+{
+    if (cache != nullptr)
+        return cache->convert(surface);
+    std::shared_ptr<ON_NurbsSurface> nurbsSurface = std::make_shared<ON_NurbsSurface>();
+    if (!surface->NurbsSurface(nurbsSurface.get()))
+        return nullptr;
+    return nurbsSurface;
+}
+
+// Write the NURBS form of a surface as an object with optional extra members
+static bool writeSurfaceObject(const ON_NurbsSurface *nurbsSurface, Config &cfg, GeometrySink &sink, const std::function<void(const ON_NurbsSurface &)> &extraMembers = nullptr)
+{
+    if (nurbsSurface == nullptr)
+        return false;
+
+    sink.beginObject();
+    // Tessellation may replace the NURBS data
+    if (cfg.tessellate() != "only")
+        writeNurbsSurfaceMembers(nurbsSurface, cfg, sink);
+    if (extraMembers)
+        extraMembers(*nurbsSurface);
+    sink.endObject();
+    return true;
+}
+
+// Write the tessellation of a surface as a "mesh" member, or as the object members if it replaces the NURBS data
+static void writeSurfaceMesh(const TriangleMesh &mesh, Config &cfg, GeometrySink &sink)
+{
+    if (cfg.tessellate() == "only")
     {
-        // Get parametric domain
-        double* dV = nurbsSurface->Domain(1).m_t;
-
-        // Normalize knot vector
-        knotVectorV.append((nurbsSurface->SuperfluousKnot(1, false) - dV[0]) / (dV[1] - dV[0]));
-        for (int idx = 0; idx < nurbsSurface->KnotCount(1); idx++)
-            knotVectorV[idx + 1] = (nurbsSurface->Knot(1, idx) - dV[0]) / (dV[1] - dV[0]);
-        knotVectorV.append((nurbsSurface->SuperfluousKnot(1, true) - dV[0]) / (dV[1] - dV[0]));
+        sink.writeDoubleArray("vertices", mesh.vertices.data(), mesh.vertices.size());
+        if (!mesh.normals.empty())
+            sink.writeDoubleArray("normals", mesh.normals.data(), mesh.normals.size());
+        sink.writeIntArray("indices", mesh.indices.data(), mesh.indices.size());
     }
     else
-    {
-        knotVectorV.append(nurbsSurface->SuperfluousKnot(1, false));
-        for (int idx = 0; idx < nurbsSurface->KnotCount(1); idx++)
-            knotVectorV[idx + 1] = nurbsSurface->Knot(1, idx);
-        knotVectorV.append(nurbsSurface->SuperfluousKnot(1, true));
-    }
-    data["knotvector_v"] = knotVectorV;
+        writeTriangleMesh(mesh, sink, "mesh");
+}
 
-    Json::Value controlPoints;
-    Json::Value points;
-    Json::Value weights;
+// Read the render mesh cached on an object (if enabled) to use instead of tessellating
+static bool readRenderMesh(const ON_Mesh *renderMesh, Config &cfg, TriangleMesh &mesh)
+{
+    if (cfg.tessellate() == "none" || !cfg.render_meshes())
+        return false;
+    return readCachedMesh(renderMesh, mesh);
+}
 
-    // Get control points adn weights
-    int sizeU = nurbsSurface->CVCount(0);
-    int sizeV = nurbsSurface->CVCount(1);
-    for (int idxU = 0; idxU < sizeU; idxU++)
-    {
-        for (int idxV = 0; idxV < sizeV; idxV++)
-        {
-            int idx = surfaceCvIndex(idxU, idxV, sizeU, sizeV);
-            double* vertex = nurbsSurface->CV(idxU, idxV);
-            double weight = nurbsSurface->Weight(idxU, idxV);
-            Json::Value point;
-            for (int c = 0; c < nurbsSurface->Dimension(); c++)
-            {
-                point[c] = vertex[c] / weight;
-            }
-            points[idx] = point;
-            weights[idx] = weight;
-        }
-    }
-    controlPoints["points"] = points;
-    controlPoints["weights"] = weights;
+// Write a mesh as an object on its own, i.e. without converting the surface to its NURBS form
+static void writeMeshObject(const TriangleMesh &mesh, Config &cfg, GeometrySink &sink)
+{
+    sink.beginObject();
+    writeSurfaceMesh(mesh, cfg, sink);
+    sink.endObject();
+}
+
+// Tessellate an untrimmed surface (if enabled) and write the mesh
+static void writeUntrimmedSurfaceMesh(const ON_NurbsSurface &nurbsSurface, Config &cfg, GeometrySink &sink)
+{
+    if (cfg.tessellate() == "none")
+        return;
+    TriangleMesh mesh;
+    tessellateSurface(nurbsSurface, std::vector<TrimPolyline>(), cfg.chord_tolerance(), false, mesh);
+    writeSurfaceMesh(mesh, cfg, sink);
+}
+
+unsigned int extractNurbsCurveData(const ON_Geometry* geometry, Config &cfg, GeometrySink &sink, double *paramOffset, double *paramLength)
+{
+    // We expect a curve object
+    if (ON::object_type::curve_object != geometry->ObjectType())
+        return 0;
 
-    data["size_u"] = sizeU;
-    data["size_v"] = sizeV;
-    data["control_points"] = controlPoints;
+    // We know that "geometry" is a curve object
+    const ON_Curve *curve = (ON_Curve *)geometry;
+
+    // Try to get the NURBS form of the curve object
+    ON_NurbsCurve nurbsCurve;
+    if (!curve->NurbsCurve(&nurbsCurve))
+        return 0;
+
+    sink.beginObject();
+    writeNurbsCurveMembers(nurbsCurve, cfg, sink, paramOffset, paramLength);
+    sink.endObject();
+    return 1;
 }
 
-void extractSurfaceData(const ON_Geometry* geometry, Config &cfg, Json::Value &data)
+void extractNurbsSurfaceData(const ON_NurbsSurface* nurbsSurface, Config& cfg, GeometrySink& sink)
+{
+    sink.beginObject();
+    writeNurbsSurfaceMembers(nurbsSurface, cfg, sink);
+    sink.endObject();
+}
+
+unsigned int extractSurfaceData(const ON_Geometry* geometry, Config &cfg, GeometrySink &sink, SurfaceCache *cache)
 {
     // We expect a surface object
     if (ON::object_type::surface_object != geometry->ObjectType())
-        return;
+        return 0;
 
     // We know that "geometry" is a surface object
     const ON_Surface *surface = (ON_Surface *)geometry;
 
-    // Try to get the NURBS form of the surface object
-    ON_NurbsSurface nurbsSurface;
-    if (surface->NurbsSurface(&nurbsSurface))
-    {
-        // Extract NURBS surface data
-        extractNurbsSurfaceData(&nurbsSurface, cfg, data);
-    }
+    // Extract NURBS surface data
+    return (writeSurfaceObject(convertSurface(surface, cache).get(), cfg, sink, [&](const ON_NurbsSurface &nurbsSurface) {
+        writeUntrimmedSurfaceMesh(nurbsSurface, cfg, sink);
+    })) ? 1 : 0;
 }
 
-void extractExtrusionData(const ON_Geometry* geometry, Config& cfg, Json::Value& data)
+unsigned int extractExtrusionData(const ON_Geometry* geometry, Config& cfg, GeometrySink& sink, SurfaceCache *cache)
 {
     // We expect an extrusion object
     if (ON::object_type::extrusion_object != geometry->ObjectType())
-        return;
+        return 0;
 
     // We know that "geometry" is an extrusion object
-    ON_Extrusion* extr = (ON_Extrusion*)geometry;
+    const ON_Extrusion* extr = (ON_Extrusion*)geometry;
 
-    // Try to get the NURBS surface form of the extrusion object
-    ON_NurbsSurface nurbsSurface;
-    if (extr->NurbsSurface(&nurbsSurface))
+    // The cached render mesh replaces the tessellation
+    TriangleMesh renderMesh;
+    bool cachedMesh = readRenderMesh(extr->Mesh(ON::render_mesh), cfg, renderMesh);
+    if (cachedMesh && cfg.tessellate() == "only")
     {
-        // Extract NURBS surface data
-        extractNurbsSurfaceData(&nurbsSurface, cfg, data);
+        writeMeshObject(renderMesh, cfg, sink);
+        return 1;
     }
+
+    // Extract the NURBS surface form of the extrusion object
+    return (writeSurfaceObject(convertSurface(extr, cache).get(), cfg, sink, [&](const ON_NurbsSurface &nurbsSurface) {
+        if (cachedMesh)
+            writeSurfaceMesh(renderMesh, cfg, sink);
+        else
+            writeUntrimmedSurfaceMesh(nurbsSurface, cfg, sink);
+    })) ? 1 : 0;
 }
 
-void extractBrepData(const ON_Geometry* geometry, Config &cfg, Json::Value &data)
+// Trim curve of a face in NURBS form
+struct TrimCurveData {
+    ON_NurbsCurve nurbsCurve;
+    double paramOffset[2];
+    double paramLength[2];
+    bool reversed;
+};
+
+// Trim loop of a face
+struct TrimLoopData {
+    std::vector<TrimCurveData> curves;
+    bool outer;
+};
+
+// Face of a BRep object with its trims and tessellation
+struct FaceData {
+    const ON_BrepFace *face;
+    const ON_Surface *surface;
+    std::shared_ptr<const ON_NurbsSurface> nurbsSurface;
+    std::vector<TrimLoopData> trimLoops;
+    std::vector<TrimPolyline> trimPolylines;
+    TriangleMesh mesh;
+    bool cachedMesh;
+};
+
+unsigned int extractBrepData(const ON_Geometry* geometry, Config &cfg, GeometrySink &sink, SurfaceCache *cache)
 {
     // We expect a BRep object
     if (ON::object_type::brep_object != geometry->ObjectType())
-        return;
+        return 0;
 
     // We know that "geometry" is a BRep object
     ON_Brep *brep = (ON_Brep *)geometry;
@@ -243,6 +289,8 @@ void extractBrepData(const ON_Geometry* geometry, Config &cfg, Json::Value &data
     brep->Compact();
 
     // Face loop
+    bool tessellate = (cfg.tessellate() != "none");
+    std::vector<FaceData> faces;
     unsigned int faceIdx = 0;
     ON_BrepFace *brepFace;
     while (brepFace = brep->Face(faceIdx))
@@ -250,173 +298,355 @@ void extractBrepData(const ON_Geometry* geometry, Config &cfg, Json::Value &data
         const ON_Surface *faceSurf = brepFace->SurfaceOf();
         if (faceSurf)
         {
-            Json::Value surfData;
-            extractSurfaceData(faceSurf, cfg, surfData);
-            // Only add to the array if JSON output is not empty
-            if (!surfData.empty())
+            FaceData faceData;
+            faceData.face = brepFace;
+            faceData.surface = faceSurf;
+
+            // A cached render mesh makes the trim polylines unnecessary
+            faceData.cachedMesh = readRenderMesh(brepFace->Mesh(ON::render_mesh), cfg, faceData.mesh);
+            bool sampleTrims = tessellate && !faceData.cachedMesh;
+
+            // Convert the trims first, so that only the non-empty loops are written
+            if (cfg.trims() || sampleTrims)
             {
-                // Add face sense
-                if (cfg.sense())
-                    surfData["reversed"] = !brepFace->m_bRev;
+                unsigned int loopIdx = 0;
+                ON_BrepLoop *brepLoop;
 
-                // Process trims
-                if (cfg.trims())
+                // Use loops to get trim information
+                while (brepLoop = brepFace->Loop(loopIdx))
                 {
-                    Json::Value trimCurvesData;
-                    unsigned int loopIdx = 0;
-                    ON_BrepLoop *brepLoop;
+                    TrimLoopData loopData;
+                    loopData.outer = (brepLoop->m_type == ON_BrepLoop::TYPE::outer);
+                    unsigned int trimIdx = 0;
+                    ON_BrepTrim *brepTrim;
 
-                    // Use loops to get trim information
-                    while (brepLoop = brepFace->Loop(loopIdx))
+                    // Extract the trim inside the loop
+                    while (brepTrim = brepLoop->Trim(trimIdx))
                     {
-                        Json::Value trimLoopData;
-                        unsigned int trimIdx = 0;
-                        ON_BrepTrim *brepTrim;
-
-                        // Extract the trim inside the loop
-                        while (brepTrim = brepLoop->Trim(trimIdx))
+                        // Try to get the trim curve from the BRep structure
+                        const ON_Curve *trimCurve = brepTrim->TrimCurveOf();
+                        TrimCurveData curveData;
+                        if (trimCurve && trimCurve->NurbsCurve(&curveData.nurbsCurve))
                         {
-                            // Try to get the trim curve from the BRep structure
-                            const ON_Curve *trimCurve = brepTrim->TrimCurveOf();
-                            if (trimCurve)
+                            // Get surface domain for normalization of trimming curves
+                            ON_Interval dom_u = brepTrim->SurfaceOf()->Domain(0);
+                            ON_Interval dom_v = brepTrim->SurfaceOf()->Domain(1);
+
+                            // Prepare parameter space offset and length
+                            curveData.paramOffset[0] = dom_u.m_t[0];
+                            curveData.paramOffset[1] = dom_v.m_t[0];
+                            curveData.paramLength[0] = dom_u.Length();
+                            curveData.paramLength[1] = dom_v.Length();
+                            curveData.reversed = !brepTrim->m_bRev3d;
+                            loopData.curves.push_back(curveData);
+
+                            // The trim polylines bound the tessellation
+                            if (sampleTrims)
                             {
-                                // Get surface domain for normalization of trimming curves
-                                ON_Interval dom_u = brepTrim->SurfaceOf()->Domain(0);
-                                ON_Interval dom_v = brepTrim->SurfaceOf()->Domain(1);
-
-                                // Prepare parameter space offset and length
-                                double paramOffset[2] = { dom_u.m_t[0], dom_v.m_t[0] };
-                                double paramLength[2] = { dom_u.Length(), dom_v.Length() };
-
-                                // Extract trim curve data
-                                Json::Value curveData;
-                                extractNurbsCurveData(trimCurve, cfg, curveData, paramOffset, paramLength);
-
-                                // Only add to the array if JSON output is not empty
-                                if (!curveData.empty())
-                                {
-                                    if (cfg.sense())
-                                        curveData["reversed"] = !brepTrim->m_bRev3d;
-                                    curveData["type"] = "spline";
-                                    trimLoopData.append(curveData);
-                                }
+                                faceData.trimPolylines.emplace_back();
+                                sampleTrimCurve(curveData.nurbsCurve, faceData.trimPolylines.back());
                             }
-
-                            // Increment trim traversing index
-                            trimIdx++;
                         }
 
-                        // Create a container type trim
-                        if (trimLoopData.size() > 0)
-                        {
-                            Json::Value trimData;
-                            trimData["type"] = "container";
-                            trimData["data"] = trimLoopData;
-                            trimData["count"] = trimLoopData.size();
-                            // Detect the sense
-                            trimData["reversed"] = (brepLoop->m_type == ON_BrepLoop::TYPE::outer) ? true : false;
-
-                            // Add trim container to the JSON array
-                            trimCurvesData.append(trimData);
-                        }
-
-                        // Increment loop traversing index
-                        loopIdx++;
+                        // Increment trim traversing index
+                        trimIdx++;
                     }
 
-                    // Due to the standardization, there should be 1 surface
-                    if (trimCurvesData.size() > 0)
-                    {
-                        Json::Value trimData;
-                        trimData["count"] = trimCurvesData.size();
-                        trimData["data"] = trimCurvesData;
+                    // Only the loops with trim curves are extracted
+                    if (!loopData.curves.empty() && cfg.trims())
+                        faceData.trimLoops.push_back(loopData);
 
-                        // Assign trims to the first surface
-                        surfData["trims"] = trimData;
-                    }
+                    // Increment loop traversing index
+                    loopIdx++;
                 }
-
-                // Add extracted surface to the JSON array
-                data.append(surfData);
             }
+            faces.push_back(std::move(faceData));
         }
 
         // Increment face traversing index
         faceIdx++;
     }
+
+    // Tessellate the faces on worker threads (unless the objects are already extracted in parallel); the conversion alone is not worth the thread start-up
+    unsigned int faceThreads = (tessellate && !cfg.parallel()) ? cfg.threads() : 1;
+    parallelFor(faces.size(), faceThreads, [&](std::size_t idx) {
+        FaceData &faceData = faces[idx];
+        if (faceData.cachedMesh && cfg.tessellate() == "only")
+            return;
+
+        // The same NURBS form is tessellated and written
+        faceData.nurbsSurface = convertSurface(faceData.surface, cache);
+        if (tessellate && !faceData.cachedMesh && faceData.nurbsSurface)
+            tessellateSurface(*faceData.nurbsSurface, faceData.trimPolylines, cfg.chord_tolerance(), faceData.face->m_bRev, faceData.mesh);
+    });
+
+    // Write the face surfaces with their sense, trims and tessellation
+    unsigned int count = 0;
+    for (auto &faceData : faces)
+    {
+        if (faceData.cachedMesh && cfg.tessellate() == "only")
+        {
+            writeMeshObject(faceData.mesh, cfg, sink);
+            count++;
+            continue;
+        }
+        bool extracted = writeSurfaceObject(faceData.nurbsSurface.get(), cfg, sink, [&](const ON_NurbsSurface &) {
+            if (tessellate)
+                writeSurfaceMesh(faceData.mesh, cfg, sink);
+            if (cfg.tessellate() == "only")
+                return;
+
+            // Add face sense
+            if (cfg.sense())
+                sink.writeBool("reversed", !faceData.face->m_bRev);
+
+            // Due to the standardization, there should be 1 surface
+            if (faceData.trimLoops.empty())
+                return;
+            sink.beginObject("trims");
+            sink.writeInt("count", faceData.trimLoops.size());
+            sink.beginArray("data");
+            for (auto &loopData : faceData.trimLoops)
+            {
+                // Create a container type trim
+                sink.beginObject();
+                sink.writeString("type", "container");
+                sink.writeInt("count", loopData.curves.size());
+                // Detect the sense
+                sink.writeBool("reversed", loopData.outer);
+                sink.beginArray("data");
+                for (auto &curveData : loopData.curves)
+                {
+                    sink.beginObject();
+                    writeNurbsCurveMembers(curveData.nurbsCurve, cfg, sink, curveData.paramOffset, curveData.paramLength);
+                    if (cfg.sense())
+                        sink.writeBool("reversed", curveData.reversed);
+                    sink.writeString("type", "spline");
+                    sink.endObject();
+                }
+                sink.endArray();
+                sink.endObject();
+            }
+            sink.endArray();
+            sink.endObject();
+        });
+        if (extracted)
+            count++;
+    }
+    return count;
 }
 
-void constructNurbsCurveData(Json::Value &data, Config &cfg, ON_NurbsCurve *&nurbsCurve)
+unsigned int extractMeshData(const ON_Geometry* geometry, Config &cfg, GeometrySink &sink)
 {
-    // Control points array
-    Json::Value ctrlpts = data["control_points"];
+    // We expect a mesh object
+    if (ON::object_type::mesh_object != geometry->ObjectType())
+        return 0;
+
+    // We know that "geometry" is a mesh object
+    const ON_Mesh *mesh = (ON_Mesh *)geometry;
+    int vertexCount = mesh->VertexCount();
+    int faceCount = mesh->FaceCount();
+    if (vertexCount == 0 || faceCount == 0)
+        return 0;
+
+    // The buffers are packed straight from the mesh arrays; triangles repeat their third vertex index
+    std::vector<unsigned char> buffer;
+    sink.beginObject();
+    sink.writeString("type", "mesh");
+    sink.writeString("encoding", RW3DM_PACKED_ENCODING);
+    sink.writeInt("vertex_count", vertexCount);
+    sink.writeInt("face_count", faceCount);
+    packValues((const float *)mesh->m_V.Array(), 3 * (std::size_t)vertexCount, buffer);
+    sink.writeBytes("vertex_buffer", buffer.data(), buffer.size());
+    if (mesh->HasVertexNormals())
+    {
+        packValues((const float *)mesh->m_N.Array(), 3 * (std::size_t)vertexCount, buffer);
+        sink.writeBytes("normal_buffer", buffer.data(), buffer.size());
+    }
+    if (mesh->HasTextureCoordinates())
+    {
+        packValues((const float *)mesh->m_T.Array(), 2 * (std::size_t)vertexCount, buffer);
+        sink.writeBytes("texture_coordinate_buffer", buffer.data(), buffer.size());
+    }
+    packValues((const int *)mesh->m_F.Array(), 4 * (std::size_t)faceCount, buffer);
+    sink.writeBytes("face_buffer", buffer.data(), buffer.size());
+    sink.endObject();
+    return 1;
+}
 
-    // Spatial dimension
-    int dimension = (data.isMember("dimension")) ? data["dimension"].asInt() : ctrlpts["points"][0].size();
+unsigned int extractPointCloudData(const ON_Geometry* geometry, Config &cfg, GeometrySink &sink)
+{
+    // We expect a point cloud object
+    if (ON::object_type::pointset_object != geometry->ObjectType())
+        return 0;
+
+    // We know that "geometry" is a point cloud object
+    const ON_PointCloud *pointCloud = (ON_PointCloud *)geometry;
+    std::size_t pointCount = (std::size_t)pointCloud->PointCount();
+    if (pointCount == 0)
+        return 0;
+    bool hasColors = pointCloud->HasPointColors();
+    bool hasNormals = pointCloud->HasPointNormals();
+    bool singlePrecision = (cfg.coordinates() == "float32");
+    std::size_t chunkSize = std::max(cfg.point_chunk_size(), (std::size_t)1);
+
+    sink.beginObject();
+    sink.writeString("type", "point_cloud");
+    sink.writeString("encoding", RW3DM_PACKED_ENCODING);
+    sink.writeInt("point_count", pointCount);
+    sink.writeString("point_format", (singlePrecision) ? "float32" : "float64");
+    sink.beginArray("chunks");
+
+    // Each chunk is packed and passed to the sink on its own, so that the streaming backends never hold the whole cloud
+    const double *points = (const double *)pointCloud->m_P.Array();
+    const double *normals = (hasNormals) ? (const double *)pointCloud->m_N.Array() : nullptr;
+    std::vector<unsigned char> buffer;
+    std::vector<float> values;
+    for (std::size_t first = 0; first < pointCount; first += chunkSize)
+    {
+        std::size_t count = std::min(chunkSize, pointCount - first);
+        sink.beginObject();
+        sink.writeInt("count", count);
 
-    // Number of control points
-    int numCtrlpts = data["control_points"]["points"].size();
+        // Positions in double or single precision
+        if (singlePrecision)
+        {
+            values.assign(points + 3 * first, points + 3 * (first + count));
+            packValues(values.data(), values.size(), buffer);
+        }
+        else
+            packValues(points + 3 * first, 3 * count, buffer);
+        sink.writeBytes("point_buffer", buffer.data(), buffer.size());
+
+        // RGB colors (one byte per component)
+        if (hasColors)
+        {
+            buffer.resize(3 * count);
+            for (std::size_t idx = 0; idx < count; idx++)
+            {
+                const ON_Color &color = pointCloud->m_C[(int)(first + idx)];
+                buffer[3 * idx] = (unsigned char)color.Red();
+                buffer[3 * idx + 1] = (unsigned char)color.Green();
+                buffer[3 * idx + 2] = (unsigned char)color.Blue();
+            }
+            sink.writeBytes("color_buffer", buffer.data(), buffer.size());
+        }
+
+        // Normals in single precision
+        if (hasNormals)
+        {
+            values.assign(normals + 3 * first, normals + 3 * (first + count));
+            packValues(values.data(), values.size(), buffer);
+            sink.writeBytes("normal_buffer", buffer.data(), buffer.size());
+        }
+        sink.endObject();
+    }
+    sink.endArray();
+    sink.endObject();
+    return 1;
+}
+
+void extractNurbsCurveData(const ON_Geometry *geometry, Config &cfg, Json::Value &data, double *paramOffset, double *paramLength)
+{
+    JsonValueSink sink(data);
+    extractNurbsCurveData(geometry, cfg, sink, paramOffset, paramLength);
+}
+
+void extractNurbsSurfaceData(const ON_NurbsSurface *nurbsSurface, Config &cfg, Json::Value &data)
+{
+    JsonValueSink sink(data);
+    extractNurbsSurfaceData(nurbsSurface, cfg, sink);
+}
+
+void extractSurfaceData(const ON_Geometry *geometry, Config &cfg, Json::Value &data, SurfaceCache *cache)
+{
+    JsonValueSink sink(data);
+    extractSurfaceData(geometry, cfg, sink, cache);
+}
+
+void extractExtrusionData(const ON_Geometry *geometry, Config &cfg, Json::Value &data, SurfaceCache *cache)
+{
+    JsonValueSink sink(data);
+    extractExtrusionData(geometry, cfg, sink, cache);
+}
+
+void extractBrepData(const ON_Geometry *geometry, Config &cfg, Json::Value &data, SurfaceCache *cache)
+{
+    // BRep faces are extracted as an array
+    JsonValueSink sink(data, true);
+    if (extractBrepData(geometry, cfg, sink, cache) == 0)
+        data = Json::Value();
+}
+
+void extractMeshData(const ON_Geometry *geometry, Config &cfg, Json::Value &data)
+{
+    JsonValueSink sink(data);
+    extractMeshData(geometry, cfg, sink);
+}
+
+void extractPointCloudData(const ON_Geometry *geometry, Config &cfg, Json::Value &data)
+{
+    JsonValueSink sink(data);
+    extractPointCloudData(geometry, cfg, sink);
+}
+
+void constructNurbsCurveData(const GeometryRecord &record, Config &cfg, ON_NurbsCurve *&nurbsCurve)
+{
+    // Spatial dimension
+    int dimension = record.controlPointDimension();
 
     // Create a curve instance
     nurbsCurve = ON_NurbsCurve::New(
         dimension,
-        (data.isMember("rational")) ? data["rational"].asInt() : 1,
-        data["degree"].asInt() + 1,
-        numCtrlpts
+        (record.rational >= 0) ? record.rational : 1,
+        record.degree[0] + 1,
+        record.controlPointCount()
     );
 
-    // Set knot vector
-    for (int idx = 0; idx < nurbsCurve->KnotCount(); idx++)
-        nurbsCurve->SetKnot(idx, data["knotvector"][idx + 1].asDouble());
+    // Set knot vector (skipping the superfluous first knot)
+    const std::vector<double> &knots = record.knots[0];
+    for (int idx = 0; idx < nurbsCurve->KnotCount() && idx + 1 < (int)knots.size(); idx++)
+        nurbsCurve->SetKnot(idx, knots[idx + 1]);
 
     // Set control points
     for (int idx = 0; idx < nurbsCurve->CVCount(); idx++)
-    {
-        // Extract control point
-        Json::Value cptData = ctrlpts["points"][idx];
-        // Extract weight
-        double w = (ctrlpts.isMember("weights")) ? ctrlpts["weights"][idx].asDouble() : 1.0;
-
-        // Create a control vertex
-        ON_4dPoint cptw;
-        cptw.x = cptData[0].asDouble() * w;
-        cptw.y = cptData[1].asDouble() * w;
-        cptw.z = (dimension == 2) ? 0.0 : cptData[2].asDouble() * w;
-        cptw.w = w;
-
-        // Set control vertex
-        nurbsCurve->SetCV(idx, cptw);
-    }
+        nurbsCurve->SetCV(idx, record.controlPoint(idx, dimension));
 }
 
-void constructNurbsSurfaceData(Json::Value &data, Config &cfg, ON_Brep *&brep)
+void constructNurbsCurveData(Json::Value &data, Config &cfg, ON_NurbsCurve *&nurbsCurve)
 {
-    // Control points array
-    Json::Value ctrlpts = data["control_points"];
+    GeometryRecord record;
+    GeometryRecordBuilder builder(record);
+    writeJsonValue(data, builder);
+    constructNurbsCurveData(record, cfg, nurbsCurve);
+}
 
+void constructNurbsSurfaceData(const GeometryRecord &record, Config &cfg, ON_Brep *&brep)
+{
     // Spatial dimension
-    int dimension = (data.isMember("dimension")) ? data["dimension"].asInt() : ctrlpts["points"][0].size();
+    int dimension = record.controlPointDimension();
 
     // Number of control points
-    int sizeU = data["size_u"].asInt();
-    int sizeV = data["size_v"].asInt();
+    int sizeU = record.size[0];
+    int sizeV = record.size[1];
 
     // Create a surface instance
     ON_NurbsSurface *nurbsSurface = ON_NurbsSurface::New(
         dimension,
-        (data.isMember("rational")) ? data["rational"].asInt() : 1,
-        data["degree_u"].asInt() + 1,
-        data["degree_v"].asInt() + 1,
+        (record.rational >= 0) ? record.rational : 1,
+        record.degree[0] + 1,
+        record.degree[1] + 1,
         sizeU,
         sizeV
     );
 
-    // Set knot vectors
-    for (int idx = 0; idx < nurbsSurface->KnotCount(0); idx++)
-        nurbsSurface->SetKnot(0, idx, data["knotvector_u"][idx + 1].asDouble());
-    for (int idx = 0; idx < nurbsSurface->KnotCount(1); idx++)
-        nurbsSurface->SetKnot(1, idx, data["knotvector_v"][idx + 1].asDouble());
-
+    // Set knot vectors (skipping the superfluous first knots)
+    for (int dir = 0; dir < 2; dir++)
+    {
+        const std::vector<double> &knots = record.knots[dir];
+        for (int idx = 0; idx < nurbsSurface->KnotCount(dir) && idx + 1 < (int)knots.size(); idx++)
+            nurbsSurface->SetKnot(dir, idx, knots[idx + 1]);
+    }
 
     // Set control points
     for (int idxU = 0; idxU < nurbsSurface->CVCount(0); idxU++)
@@ -424,14 +654,10 @@ void constructNurbsSurfaceData(Json::Value &data, Config &cfg, ON_Brep *&brep)
         for (int idxV = 0; idxV < nurbsSurface->CVCount(1); idxV++)
         {
             int idx = surfaceCvIndex(idxU, idxV, sizeU, sizeV);
-            // Extract P
-            Json::Value cptData = ctrlpts["points"][idx];
-            // Extract weight
-            double w = (ctrlpts.isMember("weights")) ? ctrlpts["weights"][idx].asDouble() : 1.0;
+            if (idx >= record.controlPointCount())
+                continue;
             // OpenNURBS uses Pw format
-            ON_4dPoint cptw(cptData[0].asDouble() * w, cptData[1].asDouble() * w, cptData[2].asDouble() * w, w);
-            // Set control vertex in OpenNURBS data
-            nurbsSurface->SetCV(idxU, idxV, cptw);
+            nurbsSurface->SetCV(idxU, idxV, record.controlPoint(idx, dimension));
         }
     }
 
@@ -449,30 +675,21 @@ void constructNurbsSurfaceData(Json::Value &data, Config &cfg, ON_Brep *&brep)
     }
 
     // Process trims
-    if (data.isMember("trims"))
+    if (!record.trims.empty())
     {
-        Json::Value trims = data["trims"];
-        if (trims.isMember("data"))
+        for (auto &trim : record.trims)
         {
-            // Loop trims array
-            ONX_Model trimModel;
-            for (auto trim : trims["data"])
+            // Add trim curve to brep
+            if (trim.type == "spline")
+                constructBsplineTrimCurve(trim, cfg, brep);
+            else if (trim.type == "freeform")
+                constructFreeformTrimCurve(trim, cfg, brep);
+            else if (trim.type == "container")
+                constructContainerTrimCurve(trim, cfg, brep);
+            else
             {
-                // Get trim type
-                std::string trimType = trim["type"].asString();
-
-                // Add trim curve to brep
-                if (trimType == "spline")
-                    constructBsplineTrimCurve(trim, cfg, brep);
-                else if (trimType == "freeform")
-                    constructFreeformTrimCurve(trim, cfg, brep);
-                else if (trimType == "container")
-                    constructContainerTrimCurve(trim, cfg, brep);
-                else
-                {
-                    // Skip unsupported trim format
-                    continue;
-                }
+                // Skip unsupported trim format
+                continue;
             }
         }
         // Set necessary trim flags
@@ -494,8 +711,70 @@ void constructNurbsSurfaceData(Json::Value &data, Config &cfg, ON_Brep *&brep)
     }
 }
 
+void constructNurbsSurfaceData(Json::Value &data, Config &cfg, ON_Brep *&brep)
+{
+    GeometryRecord record;
+    GeometryRecordBuilder builder(record);
+    writeJsonValue(data, builder);
+    constructNurbsSurfaceData(record, cfg, brep);
+}
 
-void constructBsplineTrimCurve(Json::Value& trim, Config& cfg, ON_Brep*& brep)
+void constructMeshData(const GeometryRecord &record, Config &cfg, ON_Mesh *&mesh)
+{
+    mesh = nullptr;
+
+    // Only the known encoding of the packed buffers can be read
+    if (record.encoding != RW3DM_PACKED_ENCODING)
+    {
+        if (!cfg.silent())
+            std::cout << "[WARNING] Skipped a mesh with unsupported buffer encoding '" << record.encoding << "'" << std::endl;
+        return;
+    }
+
+    // Check the buffer sizes and the vertex indices of the faces
+    std::size_t vertexCount = record.vertices.size() / 3;
+    std::size_t faceCount = record.faces.size() / 4;
+    bool valid = vertexCount > 0 && faceCount > 0 && record.vertices.size() % 3 == 0 && record.faces.size() % 4 == 0
+        && (record.normals.empty() || record.normals.size() == 3 * vertexCount)
+        && (record.textureCoordinates.empty() || record.textureCoordinates.size() == 2 * vertexCount);
+    for (std::size_t idx = 0; valid && idx < record.faces.size(); idx++)
+        valid = record.faces[idx] >= 0 && (std::size_t)record.faces[idx] < vertexCount;
+    if (!valid)
+    {
+        if (!cfg.silent())
+            std::cout << "[WARNING] Skipped a mesh with inconsistent vertex or face buffers" << std::endl;
+        return;
+    }
+
+    // Create a mesh instance
+    bool hasNormals = !record.normals.empty();
+    bool hasTextureCoordinates = !record.textureCoordinates.empty();
+    mesh = new ON_Mesh((int)faceCount, (int)vertexCount, hasNormals, hasTextureCoordinates);
+
+    // Set vertices, normals and texture coordinates
+    for (std::size_t idx = 0; idx < vertexCount; idx++)
+    {
+        mesh->m_V.Append(ON_3fPoint(record.vertices[3 * idx], record.vertices[3 * idx + 1], record.vertices[3 * idx + 2]));
+        if (hasNormals)
+            mesh->m_N.Append(ON_3fVector(record.normals[3 * idx], record.normals[3 * idx + 1], record.normals[3 * idx + 2]));
+        if (hasTextureCoordinates)
+            mesh->m_T.Append(ON_2fPoint(record.textureCoordinates[2 * idx], record.textureCoordinates[2 * idx + 1]));
+    }
+
+    // Set faces (triangles repeat their third vertex index)
+    for (std::size_t idx = 0; idx < faceCount; idx++)
+    {
+        ON_MeshFace &face = mesh->m_F.AppendNew();
+        for (int k = 0; k < 4; k++)
+            face.vi[k] = record.faces[4 * idx + k];
+    }
+
+    if (!hasNormals)
+        mesh->ComputeVertexNormals();
+}
+
+
+void constructBsplineTrimCurve(const GeometryRecord &trim, Config &cfg, ON_Brep *&brep)
 {
     // Construct the trim curve
     ON_NurbsCurve* trimCurve;
@@ -524,36 +803,59 @@ void constructBsplineTrimCurve(Json::Value& trim, Config& cfg, ON_Brep*& brep)
         double t0, t1;
         trimCurve->GetDomain(&t0, &t1);
 
-        // Construct 3-dimensional mapping of the trim curve
-        double t = t0;
+        // Sample the trim curve; skip final parametric position to cheat floating point error
+        // and evaluate it separately to make sure last curve point == first curve point
         double delta = 0.001;
+        std::vector<double> params;
+        for (double t = t0; t < t1; t += delta)
+            params.push_back(t);
+        params.push_back(t1);
+
+        // Evaluate the trim curve at all parameters at once
+        int trimDimension = trimCurve->Dimension();
+        std::vector<double> uvPoints(params.size() * trimDimension);
+        NurbsCurveEvaluator(*trimCurve).evaluate(params.data(), params.size(), uvPoints.data());
+
+        // Evaluate surface only if trim curve is on the surface
+        // Trim curve domain range == surface domain range
+        std::vector<double> us, vs;
+        for (std::size_t idx = 0; idx < params.size() && trimDimension >= 2; idx++)
+        {
+            double u = uvPoints[idx * trimDimension];
+            double v = uvPoints[idx * trimDimension + 1];
+            if ((u >= st0_u) && (u <= st1_u) && (v >= st0_v) && (v <= st1_v))
+            {
+                us.push_back(u);
+                vs.push_back(v);
+            }
+        }
+
+        // Construct 3-dimensional mapping of the trim curve
         ON_3dPointArray eptArray;
         ON_SimpleArray<double> paramsArray;
-        ON_3dPoint uv;
-        ON_3dPoint ept;
-        // Skip final parametric position to cheat floating point error
-        while (t < t1)
+        eptArray.Reserve(us.size());
+        const ON_NurbsSurface *nurbsSurf = ON_NurbsSurface::Cast(surf);
+        if (nurbsSurf != nullptr)
         {
-            trimCurve->EvPoint(t, uv);
-            // Evaluate surface only if trim curve is on the surface
-            // Trim curve domain range == surface domain range
-            if ((uv.x >= st0_u) && (uv.x <= st1_u) && (uv.y >= st0_v) && (uv.y <= st1_v))
+            int dimension = nurbsSurf->Dimension();
+            std::vector<double> surfPoints(us.size() * dimension);
+            NurbsSurfaceEvaluator(*nurbsSurf).evaluate(us.data(), vs.data(), us.size(), surfPoints.data());
+            for (std::size_t idx = 0; idx < us.size(); idx++)
             {
-                surf->EvPoint(uv.x, uv.y, ept);
+                ON_3dPoint ept(0.0, 0.0, 0.0);
+                for (int c = 0; c < dimension && c < 3; c++)
+                    ept[c] = surfPoints[idx * dimension + c];
                 eptArray.Append(ept);
-                //paramsArray.Append(t);
             }
-            t += delta;
         }
-
-        // Evaluate the last parametric position separately
-        // to make sure last curve point == first curve point
-        trimCurve->EvPoint(t1, uv);
-        if ((uv.x >= st0_u) && (uv.x <= st1_u) && (uv.y >= st0_v) && (uv.y <= st1_v))
+        else
         {
-            surf->EvPoint(uv.x, uv.y, ept);
-            eptArray.Append(ept);
-            //paramsArray.Append(t);
+            for (std::size_t idx = 0; idx < us.size(); idx++)
+            {
+                ON_3dPoint ept;
+                surf->EvPoint(us[idx], vs[idx], ept);
+                eptArray.Append(ept);
+            }
         }
 
         ON_PolylineCurve* trimCurve3d = new ON_PolylineCurve(eptArray, paramsArray);
@@ -575,31 +877,267 @@ void constructBsplineTrimCurve(Json::Value& trim, Config& cfg, ON_Brep*& brep)
         ON_BrepLoop& loop = brep->NewLoop(ON_BrepLoop::inner, brep->m_F[0]);
 
         // Construct trim
-        bool bRev3d = (trim.isMember("reversed")) ? !trim["reversed"].asBool() : true;
-        ON_BrepTrim& trim = brep->NewTrim(edge, bRev3d, loop, t2i);
-        trim.m_type = ON_BrepTrim::boundary;
+        bool bRev3d = (trim.hasReversed) ? !trim.reversed : true;
+        ON_BrepTrim& brepTrim = brep->NewTrim(edge, bRev3d, loop, t2i);
+        brepTrim.m_type = ON_BrepTrim::boundary;
 
         // Set trim tolerance
-        trim.m_tolerance[0] = RW3DM_VAR_TOLERANCE;
-        trim.m_tolerance[1] = RW3DM_VAR_TOLERANCE;
+        brepTrim.m_tolerance[0] = RW3DM_VAR_TOLERANCE;
+        brepTrim.m_tolerance[1] = RW3DM_VAR_TOLERANCE;
     }
 }
 
 
-void constructFreeformTrimCurve(Json::Value& trim, Config& cfg, ON_Brep*& brep)
+void constructFreeformTrimCurve(const GeometryRecord &trim, Config &cfg, ON_Brep *&brep)
 {
     // TO-DO
     std::cout << "[WARNING] Extraction of freeform-type trim curves is not supported" << std::endl;
 }
 
 
-void constructContainerTrimCurve(Json::Value& trim, Config& cfg, ON_Brep*& brep)
+void constructContainerTrimCurve(const GeometryRecord &trim, Config &cfg, ON_Brep *&brep)
 {
     // TO-DO
     std::cout << "[WARNING] Extraction of container-type trim curves is not supported" << std::endl;
 }
 
 
+void writeControlPoints(const std::vector<double> &points, const std::vector<double> &weights, int dimension, bool rational, Config &cfg, GeometrySink &sink, const char *key)
+{
+    int numCtrlpts = (int)weights.size();
+    std::string coordFormat = cfg.coordinates();
+
+    sink.beginObject(key);
+
+    // Quantize coordinates w.r.t. the bounding box of the control points
+    std::vector<Json::Int64> qpoints;
+    if (coordFormat == "quantized" && numCtrlpts > 0)
+    {
+        Json::Value quantization;
+        quantizeControlPoints(points, dimension, cfg.quantize_tolerance(), qpoints, quantization);
+        writeJsonValue(quantization, sink, "quantization");
+    }
+
+    // Convert the coordinates to the configured output format; the binary output stores single precision values in 4 bytes
+    std::vector<float> floatCoords;
+    if (qpoints.empty() && coordFormat == "float32")
+        floatCoords.assign(points.begin(), points.end());
+
+    if (cfg.compact_layout())
+    {
+        // Compact layout: flat coordinate array with a stride
+        if (!qpoints.empty())
+            sink.writeIntArray("points", qpoints.data(), numCtrlpts * dimension);
+        else if (!floatCoords.empty())
+            sink.writeFloatArray("points", floatCoords.data(), numCtrlpts * dimension);
+        else
+            sink.writeDoubleArray("points", points.data(), numCtrlpts * dimension);
+        sink.writeInt("stride", dimension);
+
+        // All weights are 1.0 for non-rational geometry
+        if (rational)
+            sink.writeDoubleArray("weights", weights.data(), numCtrlpts);
+    }
+    else
+    {
+        // Regular layout: array of points and array of weights
+        sink.beginArray("points");
+        for (int idx = 0; idx < numCtrlpts; idx++)
+        {
+            if (!qpoints.empty())
+                sink.writeIntArray(nullptr, &qpoints[idx * dimension], dimension);
+            else if (!floatCoords.empty())
+                sink.writeFloatArray(nullptr, &floatCoords[idx * dimension], dimension);
+            else
+                sink.writeDoubleArray(nullptr, &points[idx * dimension], dimension);
+        }
+        sink.endArray();
+        sink.writeDoubleArray("weights", weights.data(), numCtrlpts);
+    }
+
+    sink.endObject();
+}
+
+void writeControlPoints(const std::vector<double> &points, const std::vector<double> &weights, int dimension, bool rational, Config &cfg, Json::Value &controlPoints)
+{
+    JsonValueSink sink(controlPoints);
+    writeControlPoints(points, weights, dimension, rational, cfg, sink);
+}
+
+void quantizeControlPoints(const std::vector<double> &points, int dimension, double tolerance, std::vector<Json::Int64> &qpoints, Json::Value &quantization)
+{
+    int numCtrlpts = (int)points.size() / dimension;
+
+    // Find the bounding box of the control points
+    std::vector<double> bmin(points.begin(), points.begin() + dimension);
+    std::vector<double> bmax(bmin);
+    for (int idx = 1; idx < numCtrlpts; idx++)
+    {
+        for (int c = 0; c < dimension; c++)
+        {
+            bmin[c] = std::min(bmin[c], points[idx * dimension + c]);
+            bmax[c] = std::max(bmax[c], points[idx * dimension + c]);
+        }
+    }
+    double extent = 0.0;
+    for (int c = 0; c < dimension; c++)
+        extent += (bmax[c] - bmin[c]) * (bmax[c] - bmin[c]);
+    extent = std::sqrt(extent);
+
+    // Choose the step so that the distance between a point and its dequantized form is within the tolerance
+    double absTolerance = (extent > 0.0) ? tolerance * extent : tolerance;
+    double step = (absTolerance > 0.0) ? 2.0 * absTolerance / std::sqrt((double)dimension) : 1.0;
+
+    // Quantize the points and measure the round-trip deviation
+    double deviation = 0.0;
+    qpoints.resize(points.size());
+    for (int idx = 0; idx < numCtrlpts; idx++)
+    {
+        double dist = 0.0;
+        for (int c = 0; c < dimension; c++)
+        {
+            int i = idx * dimension + c;
+            qpoints[i] = (Json::Int64)std::llround((points[i] - bmin[c]) / step);
+            double diff = bmin[c] + (double)qpoints[i] * step - points[i];
+            dist += diff * diff;
+        }
+        deviation = std::max(deviation, std::sqrt(dist));
+    }
+
+    Json::Value origin(Json::arrayValue);
+    for (int c = 0; c < dimension; c++)
+        origin[c] = bmin[c];
+    quantization["origin"] = origin;
+    quantization["step"] = step;
+    quantization["tolerance"] = absTolerance;
+    quantization["deviation"] = deviation;
+}
+
+unsigned int archiveTableFilter(Config &cfg)
+{
+    // Zero reads all tables
+    if (!cfg.fast_read())
+        return 0;
+
+    // Only the tables required for geometry extraction; embedded bitmaps, texture mappings,
+    // materials, history records and plug-in user tables are skipped
+    return static_cast<unsigned int>(ON_3dmArchiveTableType::start_section)
+        | static_cast<unsigned int>(ON_3dmArchiveTableType::properties_table)
+        | static_cast<unsigned int>(ON_3dmArchiveTableType::settings_table)
+        | static_cast<unsigned int>(ON_3dmArchiveTableType::layer_table)
+        | static_cast<unsigned int>(ON_3dmArchiveTableType::group_table)
+        | static_cast<unsigned int>(ON_3dmArchiveTableType::instance_definition_table)
+        | static_cast<unsigned int>(ON_3dmArchiveTableType::object_table);
+}
+
+bool parseObjectTypes(const std::string &value, bool extractCurves, unsigned int &objectFilter)
+{
+    // Object types that can be extracted
+    static const std::map<std::string, unsigned int> objectTypes = {
+        { "curve", ON::curve_object },
+        { "surface", ON::surface_object },
+        { "brep", ON::brep_object },
+        { "extrusion", ON::extrusion_object },
+        { "mesh", ON::mesh_object },
+        { "pointcloud", ON::pointset_object }
+    };
+
+    objectFilter = 0;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item == "auto")
+        {
+            // Read only the object types required by the extraction mode
+            if (extractCurves)
+                objectFilter |= ON::curve_object;
+            else
+                objectFilter |= ON::surface_object | ON::brep_object | ON::extrusion_object;
+        }
+        else
+        {
+            auto search = objectTypes.find(item);
+            if (search == objectTypes.end())
+                return false;
+            objectFilter |= search->second;
+        }
+    }
+    return objectFilter != 0;
+}
+
+bool intersectsBoundingBox(const ON_Geometry *geometry, const double *box)
+{
+    // Bounding box computation is much cheaper than the NURBS conversion
+    ON_BoundingBox bbox = geometry->BoundingBox();
+
+    // Keep the geometry if its extent cannot be determined
+    if (!bbox.IsValid())
+        return true;
+
+    return !(bbox.m_max.x < box[0] || bbox.m_min.x > box[3] ||
+             bbox.m_max.y < box[1] || bbox.m_min.y > box[4] ||
+             bbox.m_max.z < box[2] || bbox.m_min.z > box[5]);
+}
+
+void parseAttributeFilter(Config &cfg, AttributeFilter &filter)
+{
+    // Option values are already in lowercase
+    std::string item;
+    std::stringstream layers(cfg.layers());
+    while (std::getline(layers, item, ','))
+        filter.layers.insert(item);
+    std::stringstream names(cfg.names());
+    while (std::getline(names, item, ','))
+        filter.names.insert(item);
+    filter.visibleOnly = cfg.visible_only();
+}
+
+void readLayerTable(const ONX_Model &model, std::vector<LayerInfo> &layers)
+{
+    layers.clear();
+    ONX_ModelComponentIterator it(model, ON_ModelComponent::Type::Layer);
+    for (const ON_ModelComponent *component = it.FirstComponent(); component != nullptr; component = it.NextComponent())
+    {
+        const ON_Layer *layer = ON_Layer::Cast(component);
+        if (layer == nullptr || layer->Index() < 0)
+            continue;
+        if ((std::size_t)layer->Index() >= layers.size())
+            layers.resize(layer->Index() + 1, { "", true });
+        layers[layer->Index()] = { toUtf8Lower(layer->Name()), layer->IsVisible() };
+    }
+}
+
+bool matchesAttributes(const AttributeFilter &filter, const std::vector<LayerInfo> &layers, int layerIndex, const std::string &name, bool visible)
+{
+    // Objects on unknown layers only pass the filters which do not need the layer
+    const LayerInfo *layer = (layerIndex >= 0 && (std::size_t)layerIndex < layers.size()) ? &layers[layerIndex] : nullptr;
+    if (!filter.layers.empty() && (layer == nullptr || filter.layers.find(layer->name) == filter.layers.end()))
+        return false;
+    if (!filter.names.empty() && filter.names.find(name) == filter.names.end())
+        return false;
+    // Objects on hidden layers are not visible either
+    if (filter.visibleOnly && (!visible || (layer != nullptr && !layer->visible)))
+        return false;
+    return true;
+}
+
+std::string toUtf8Lower(const ON_wString &value)
+{
+    ON_String utf8(value);
+    std::string s(static_cast<const char *>(utf8));
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+std::string uuidToString(const ON_UUID &uuid)
+{
+    char buffer[64];
+    std::string s(ON_UuidToString(uuid, buffer));
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
 bool checkLinearBoundaryTrim(ON_NurbsCurve *trimCurve)
 {
     unsigned int trimValidateCount = 0;
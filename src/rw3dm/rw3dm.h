@@ -25,34 +25,96 @@ SOFTWARE.
 #define RW3DM_H
 
 #include "common.h"
+#include "geometry_sink.h"
+#include "geometry_source.h"
+#include "nurbs_kernels.h"
+#include "nurbs_evaluator.h"
+#include "tessellate.h"
 #include <opennurbs_public.h>
 #include <json/json.h>
+#include <set>
 
 #ifndef RW3DM_VAR_TOLERANCE
 #define RW3DM_VAR_TOLERANCE 10e-7
 #endif
 
+// Memoized surface conversion (see surface_cache.h)
+class SurfaceCache;
+
+// Layer properties used by the attribute filters
+struct LayerInfo {
+    std::string name;
+    bool visible;
+};
+
+// Object attribute filters (names are stored in lowercase)
+struct AttributeFilter {
+    std::set<std::string> layers;
+    std::set<std::string> names;
+    bool visibleOnly = false;
+    bool empty() const { return layers.empty() && names.empty() && !visibleOnly; }
+};
+
 // Framework initialization
 void initializeRwExt();
 void finalizeRwExt();
 
-// Geometry extraction (3DM -> geomdl)
+// Initializes the framework for the lifetime of the object, so that early returns also finalize it
+struct RwExtScope {
+    RwExtScope() { initializeRwExt(); }
+    ~RwExtScope() { finalizeRwExt(); }
+    RwExtScope(const RwExtScope &) = delete;
+    RwExtScope &operator=(const RwExtScope &) = delete;
+};
+
+// Geometry extraction (3DM -> geomdl) to a sink; returns the number of objects written
+unsigned int extractNurbsCurveData(const ON_Geometry *, Config &, GeometrySink &, double * = nullptr, double * = nullptr);
+void extractNurbsSurfaceData(const ON_NurbsSurface *, Config &, GeometrySink &);
+unsigned int extractSurfaceData(const ON_Geometry *, Config &, GeometrySink &, SurfaceCache * = nullptr);
+unsigned int extractBrepData(const ON_Geometry *, Config &, GeometrySink &, SurfaceCache * = nullptr);
+unsigned int extractExtrusionData(const ON_Geometry *, Config &, GeometrySink &, SurfaceCache * = nullptr);
+unsigned int extractMeshData(const ON_Geometry *, Config &, GeometrySink &);
+unsigned int extractPointCloudData(const ON_Geometry *, Config &, GeometrySink &);
+
+// Geometry extraction (3DM -> geomdl) to a jsoncpp tree
 void extractNurbsCurveData(const ON_Geometry *, Config &, Json::Value &, double * = nullptr, double * = nullptr);
 void extractNurbsSurfaceData(const ON_NurbsSurface *, Config &, Json::Value &);
-void extractSurfaceData(const ON_Geometry *, Config &, Json::Value &);
-void extractBrepData(const ON_Geometry *, Config &, Json::Value &);
-void extractExtrusionData(const ON_Geometry*, Config&, Json::Value&);
+void extractSurfaceData(const ON_Geometry *, Config &, Json::Value &, SurfaceCache * = nullptr);
+void extractBrepData(const ON_Geometry *, Config &, Json::Value &, SurfaceCache * = nullptr);
+void extractExtrusionData(const ON_Geometry*, Config&, Json::Value&, SurfaceCache * = nullptr);
+void extractMeshData(const ON_Geometry *, Config &, Json::Value &);
+void extractPointCloudData(const ON_Geometry *, Config &, Json::Value &);
+
+// Geometry conversion (geomdl -> 3DM) from a geometry record
+void constructNurbsCurveData(const GeometryRecord &, Config &, ON_NurbsCurve *&);
+void constructNurbsSurfaceData(const GeometryRecord &, Config &, ON_Brep *&);
+void constructMeshData(const GeometryRecord &, Config &, ON_Mesh *&);
 
-// Geometry conversion (geomdl -> 3DM)
+// Geometry conversion (geomdl -> 3DM) from a jsoncpp tree
 void constructNurbsCurveData(Json::Value &, Config &, ON_NurbsCurve *&);
 void constructNurbsSurfaceData(Json::Value &, Config &, ON_Brep *&);
 
 // Trim curve conversion (geomdl -> 3DM)
-void constructBsplineTrimCurve(Json::Value &, Config &, ON_Brep *&);
-void constructFreeformTrimCurve(Json::Value &, Config &, ON_Brep *&);
-void constructContainerTrimCurve(Json::Value &, Config &, ON_Brep *&);
+void constructBsplineTrimCurve(const GeometryRecord &, Config &, ON_Brep *&);
+void constructFreeformTrimCurve(const GeometryRecord &, Config &, ON_Brep *&);
+void constructContainerTrimCurve(const GeometryRecord &, Config &, ON_Brep *&);
+
+// Control points layout (regular or compact)
+void writeControlPoints(const std::vector<double> &, const std::vector<double> &, int, bool, Config &, GeometrySink &, const char * = nullptr);
+void writeControlPoints(const std::vector<double> &, const std::vector<double> &, int, bool, Config &, Json::Value &);
+
+// Coordinate quantization
+void quantizeControlPoints(const std::vector<double> &, int, double, std::vector<Json::Int64> &, Json::Value &);
 
 // Helper functions
+unsigned int archiveTableFilter(Config &);
+bool parseObjectTypes(const std::string &, bool, unsigned int &);
+bool intersectsBoundingBox(const ON_Geometry *, const double *);
+void parseAttributeFilter(Config &, AttributeFilter &);
+void readLayerTable(const ONX_Model &, std::vector<LayerInfo> &);
+bool matchesAttributes(const AttributeFilter &, const std::vector<LayerInfo> &, int, const std::string &, bool);
+std::string toUtf8Lower(const ON_wString &);
+std::string uuidToString(const ON_UUID &);
 bool checkLinearBoundaryTrim(ON_NurbsCurve *);
 int surfaceCvIndex(int, int, int, int);
 int volumeCvIndex(int, int, int, int, int, int);
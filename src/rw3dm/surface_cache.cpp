@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "surface_cache.h"
+
+
+SurfaceCache::SurfaceCache(std::size_t maxBytes) : m_maxBytes(maxBytes), m_bytes(0), m_hits(0), m_misses(0)
+{
+}
+
+bool SurfaceCache::key(const ON_Surface *surface, std::string &k) const
+{
+    // The serialized surface is the key, so that a hit is always an exact duplicate (user data is not a part of the geometry)
+    ON_Write3dmBufferArchive archive(0, 0, ON_BinaryArchive::CurrentArchiveVersion(), ON::Version());
+    archive.SetShouldSerializeUserDataDefault(false);
+    if (!archive.WriteObject(surface))
+        return false;
+    k.assign(static_cast<const char *>(archive.Buffer()), archive.SizeOfArchive());
+    return true;
+}
+
+std::shared_ptr<const ON_NurbsSurface> SurfaceCache::convert(const ON_Surface *surface)
+{
+    std::string k;
+    bool cacheable = key(surface, k);
+    if (cacheable)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(k);
+        if (it != m_index.end())
+        {
+            // Move the entry to the front of the LRU list
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            m_hits++;
+            return it->second->nurbsSurface;
+        }
+    }
+    m_misses++;
+
+    // Convert outside of the lock; identical surfaces converted concurrently produce the same result
+    std::shared_ptr<ON_NurbsSurface> nurbsSurface = std::make_shared<ON_NurbsSurface>();
+    if (!surface->NurbsSurface(nurbsSurface.get()))
+        return nullptr;
+    if (!cacheable)
+        return nurbsSurface;
+
+    // Approximate memory use of the entry: key, control points and knots
+    std::size_t bytes = 2 * k.size() + sizeof(Entry) + sizeof(ON_NurbsSurface)
+        + sizeof(double) * ((std::size_t)nurbsSurface->m_cv_count[0] * nurbsSurface->m_cv_count[1] * nurbsSurface->CVSize()
+        + nurbsSurface->KnotCount(0) + nurbsSurface->KnotCount(1));
+    if (bytes > m_maxBytes)
+        return nurbsSurface;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_index.find(k) == m_index.end())
+    {
+        m_entries.push_front({ k, nurbsSurface, bytes });
+        m_index.emplace(std::move(k), m_entries.begin());
+        m_bytes += bytes;
+
+        // Evict the least recently used entries
+        while (m_bytes > m_maxBytes && !m_entries.empty())
+        {
+            m_bytes -= m_entries.back().bytes;
+            m_index.erase(m_entries.back().key);
+            m_entries.pop_back();
+        }
+    }
+    return nurbsSurface;
+}
+
+unsigned int SurfaceCache::hits() const
+{
+    return m_hits;
+}
+
+unsigned int SurfaceCache::misses() const
+{
+    return m_misses;
+}
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SURFACE_CACHE_H
+#define SURFACE_CACHE_H
+
+#include "common.h"
+#include "rw3dm.h"
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Memory budget of the cached surfaces in bytes
+#ifndef RW3DM_SURFACE_CACHE_BYTES
+#define RW3DM_SURFACE_CACHE_BYTES (256 * 1024 * 1024)
+#endif
+
+/** \brief Memoizes the NURBS conversion of surfaces within a model.
+
+Surfaces are identified by their serialized data, so only exact duplicates
+(e.g. surfaces shared by faces or extrusions) reuse a conversion. Only the
+NURBS forms are kept; the least recently used entries are evicted when the
+memory budget is exceeded. The cache can be shared by worker threads.
+*/
+class SurfaceCache
+{
+public:
+    SurfaceCache(std::size_t = RW3DM_SURFACE_CACHE_BYTES);
+
+    // Returns the NURBS form of the surface, converting it only if no identical surface is cached; nullptr if the conversion fails
+    std::shared_ptr<const ON_NurbsSurface> convert(const ON_Surface *);
+
+    unsigned int hits() const;
+    unsigned int misses() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const ON_NurbsSurface> nurbsSurface;
+        std::size_t bytes;
+    };
+
+    bool key(const ON_Surface *, std::string &) const;
+
+    std::size_t m_maxBytes;
+    std::size_t m_bytes;
+    std::list<Entry> m_entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    std::mutex m_mutex;
+    std::atomic<unsigned int> m_hits;
+    std::atomic<unsigned int> m_misses;
+};
+
+#endif /* SURFACE_CACHE_H */
@@ -0,0 +1,407 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "tessellate.h"
+#include "nurbs_kernels.h"
+#include "nurbs_evaluator.h"
+#include <algorithm>
+#include <cmath>
+
+
+// Collects the nonzero knot spans of a direction (OpenNURBS knots without the superfluous knots)
+static void knotSpans(const double *knots, int order, int cvCount, std::vector<double> &breaks)
+{
+    breaks.clear();
+    breaks.push_back(knots[order - 2]);
+    for (int idx = order - 1; idx < cvCount; idx++)
+    {
+        if (knots[idx] > breaks.back())
+            breaks.push_back(knots[idx]);
+    }
+}
+
+// Distributes the segments over the knot spans
+static void spanParameters(const std::vector<double> &breaks, int segments, std::vector<double> &params)
+{
+    params.clear();
+    int spans = (int)breaks.size() - 1;
+    int perSpan = std::max(1, (segments + spans - 1) / std::max(spans, 1));
+    perSpan = std::min(perSpan, std::max(1, RW3DM_TESSELLATION_MAX_SEGMENTS / std::max(spans, 1)));
+    for (int s = 0; s < spans; s++)
+    {
+        for (int k = 0; k < perSpan; k++)
+            params.push_back(breaks[s] + (breaks[s + 1] - breaks[s]) * k / perSpan);
+    }
+    params.push_back(breaks.back());
+}
+
+// Counts the crossings of the ray from (u, v) in +u direction with the trim polylines
+static bool insideTrims(const std::vector<TrimPolyline> &trims, double u, double v)
+{
+    if (trims.empty())
+        return true;
+
+    bool inside = false;
+    for (auto &polyline : trims)
+    {
+        for (std::size_t idx = 2; idx + 1 < polyline.size(); idx += 2)
+        {
+            double u0 = polyline[idx - 2], v0 = polyline[idx - 1];
+            double u1 = polyline[idx], v1 = polyline[idx + 1];
+            if ((v0 > v) != (v1 > v) && u < u0 + (v - v0) * (u1 - u0) / (v1 - v0))
+                inside = !inside;
+        }
+    }
+    return inside;
+}
+
+void sampleTrimCurve(const ON_NurbsCurve &nurbsCurve, TrimPolyline &polyline)
+{
+    polyline.clear();
+    if (nurbsCurve.Order() < 2 || nurbsCurve.CVCount() < nurbsCurve.Order() || nurbsCurve.Dimension() < 2)
+        return;
+
+    // Linear spans need only their end points
+    std::vector<double> breaks, params;
+    knotSpans(nurbsCurve.m_knot, nurbsCurve.Order(), nurbsCurve.CVCount(), breaks);
+    int degree = nurbsCurve.Order() - 1;
+    int segments = (int)(breaks.size() - 1) * ((degree > 1) ? 4 * degree : 1);
+    spanParameters(breaks, segments, params);
+
+    int dimension = nurbsCurve.Dimension();
+    std::vector<double> points(params.size() * dimension);
+    NurbsCurveEvaluator(nurbsCurve).evaluate(params.data(), params.size(), points.data());
+    polyline.resize(params.size() * 2);
+    for (std::size_t idx = 0; idx < params.size(); idx++)
+    {
+        polyline[idx * 2] = points[idx * dimension];
+        polyline[idx * 2 + 1] = points[idx * dimension + 1];
+    }
+}
+
+void tessellateSurface(const ON_NurbsSurface &nurbsSurface, const std::vector<TrimPolyline> &trims, double tolerance, bool flip, TriangleMesh &mesh)
+{
+    mesh.vertices.clear();
+    mesh.normals.clear();
+    mesh.indices.clear();
+
+    int dimension = nurbsSurface.Dimension();
+    int sizeU = nurbsSurface.CVCount(0);
+    int sizeV = nurbsSurface.CVCount(1);
+    if (dimension < 1 || sizeU < nurbsSurface.Order(0) || sizeV < nurbsSurface.Order(1) || nurbsSurface.Order(0) < 2 || nurbsSurface.Order(1) < 2)
+        return;
+
+    // Euclidean control points (index = v + u * sizeV)
+    std::vector<double> points(sizeU * sizeV * dimension);
+    std::vector<double> weights(sizeU * sizeV);
+    dehomogenizeControlPoints(surfaceCvArray(nurbsSurface), points.data(), weights.data());
+
+    // Absolute tolerance from the extent of the control points
+    std::vector<double> bmin(points.begin(), points.begin() + dimension), bmax(bmin);
+    for (int idx = 1; idx < sizeU * sizeV; idx++)
+    {
+        for (int c = 0; c < dimension; c++)
+        {
+            bmin[c] = std::min(bmin[c], points[idx * dimension + c]);
+            bmax[c] = std::max(bmax[c], points[idx * dimension + c]);
+        }
+    }
+    double extent = 0.0;
+    for (int c = 0; c < dimension; c++)
+        extent += (bmax[c] - bmin[c]) * (bmax[c] - bmin[c]);
+    double absTolerance = (extent > 0.0) ? tolerance * std::sqrt(extent) : tolerance;
+    if (absTolerance <= 0.0)
+        absTolerance = 1e-3;
+
+    // The grid has to resolve the trim loops, so the smallest trim curve sets a minimum density
+    double minTrimExtent = 0.0;
+    for (auto &polyline : trims)
+    {
+        double umin = HUGE_VAL, umax = -HUGE_VAL, vmin = HUGE_VAL, vmax = -HUGE_VAL;
+        for (std::size_t idx = 0; idx + 1 < polyline.size(); idx += 2)
+        {
+            umin = std::min(umin, polyline[idx]);
+            umax = std::max(umax, polyline[idx]);
+            vmin = std::min(vmin, polyline[idx + 1]);
+            vmax = std::max(vmax, polyline[idx + 1]);
+        }
+        double trimExtent = std::max(umax - umin, vmax - vmin);
+        if (trimExtent > 0.0 && (minTrimExtent == 0.0 || trimExtent < minTrimExtent))
+            minTrimExtent = trimExtent;
+    }
+
+    // Grid parameters: the chord error of n segments is bounded by p (p - 1) max|P(i-1) - 2 P(i) + P(i+1)| / (8 n^2)
+    std::vector<double> params[2];
+    for (int dir = 0; dir < 2; dir++)
+    {
+        int degree = nurbsSurface.Order(dir) - 1;
+        int count = (dir == 0) ? sizeU : sizeV;
+        int rows = (dir == 0) ? sizeV : sizeU;
+        double maxDiff = 0.0;
+        for (int row = 0; row < rows; row++)
+        {
+            for (int idx = 1; idx + 1 < count; idx++)
+            {
+                int i0 = (dir == 0) ? row + (idx - 1) * sizeV : row * sizeV + idx - 1;
+                int step = (dir == 0) ? sizeV : 1;
+                double diff = 0.0;
+                for (int c = 0; c < dimension; c++)
+                {
+                    double d = points[i0 * dimension + c] - 2.0 * points[(i0 + step) * dimension + c] + points[(i0 + 2 * step) * dimension + c];
+                    diff += d * d;
+                }
+                maxDiff = std::max(maxDiff, std::sqrt(diff));
+            }
+        }
+        int segments = 1;
+        if (degree > 1)
+        {
+            double n = std::ceil(std::sqrt(degree * (degree - 1) * maxDiff / (8.0 * absTolerance)));
+            segments = (int)std::min(n, (double)RW3DM_TESSELLATION_MAX_SEGMENTS);
+        }
+
+        std::vector<double> breaks;
+        knotSpans(nurbsSurface.m_knot[dir], nurbsSurface.Order(dir), count, breaks);
+        if (minTrimExtent > 0.0)
+        {
+            double n = std::ceil(RW3DM_TESSELLATION_TRIM_SEGMENTS * (breaks.back() - breaks.front()) / minTrimExtent);
+            segments = std::max(segments, (int)std::min(n, (double)RW3DM_TESSELLATION_MAX_SEGMENTS));
+        }
+        spanParameters(breaks, segments, params[dir]);
+    }
+
+    // Evaluate the grid (index = j + i * numV)
+    std::size_t numU = params[0].size(), numV = params[1].size(), gridSize = numU * numV;
+    std::vector<double> us(gridSize), vs(gridSize);
+    for (std::size_t i = 0; i < numU; i++)
+    {
+        for (std::size_t j = 0; j < numV; j++)
+        {
+            us[i * numV + j] = params[0][i];
+            vs[i * numV + j] = params[1][j];
+        }
+    }
+
+    // The tangents on the border of the grid need points offset along u and v (forward differences, except at the end of the domain)
+    double step[2];
+    for (int dir = 0; dir < 2; dir++)
+        step[dir] = RW3DM_TESSELLATION_NORMAL_STEP * (params[dir].back() - params[dir].front());
+    std::vector<std::size_t> borderOffset(gridSize, 0);
+    for (std::size_t i = 0; i < numU; i++)
+    {
+        for (std::size_t j = 0; j < numV; j++)
+        {
+            if (i > 0 && i + 1 < numU && j > 0 && j + 1 < numV)
+                continue;
+            borderOffset[i * numV + j] = us.size();
+            us.push_back(params[0][i] + ((i + 1 < numU) ? step[0] : -step[0]));
+            vs.push_back(params[1][j]);
+            us.push_back(params[0][i]);
+            vs.push_back(params[1][j] + ((j + 1 < numV) ? step[1] : -step[1]));
+        }
+    }
+    std::vector<double> gridPoints(us.size() * dimension);
+    NurbsSurfaceEvaluator(nurbsSurface).evaluate(us.data(), vs.data(), us.size(), gridPoints.data());
+
+    auto gridPoint = [&](std::size_t idx, int c) {
+        return (c < dimension) ? gridPoints[idx * dimension + c] : 0.0;
+    };
+    auto cross = [](const double *e1, const double *e2, double *n) {
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    };
+
+    // Vertex normals from the tangents (central differences inside the grid); degenerate points (e.g. poles) use the area-weighted normals of the grid triangles around them
+    const double minTangentArea = 1e-6 * RW3DM_TESSELLATION_NORMAL_STEP * RW3DM_TESSELLATION_NORMAL_STEP * extent;
+    auto tangentNormal = [&](std::size_t idx, double *n) {
+        std::size_t i = idx / numV, j = idx % numV;
+        double su[3], sv[3];
+        for (int c = 0; c < 3; c++)
+        {
+            if (borderOffset[idx] > 0)
+            {
+                su[c] = gridPoint(borderOffset[idx], c) - gridPoint(idx, c);
+                sv[c] = gridPoint(borderOffset[idx] + 1, c) - gridPoint(idx, c);
+                if (i + 1 == numU)
+                    su[c] = -su[c];
+                if (j + 1 == numV)
+                    sv[c] = -sv[c];
+            }
+            else
+            {
+                su[c] = gridPoint(idx + numV, c) - gridPoint(idx - numV, c);
+                sv[c] = gridPoint(idx + 1, c) - gridPoint(idx - 1, c);
+            }
+        }
+        cross(su, sv, n);
+    };
+    auto fallbackNormal = [&](std::size_t idx, double *n) {
+        std::size_t i = idx / numV, j = idx % numV;
+        n[0] = n[1] = n[2] = 0.0;
+        for (std::size_t ci = (i > 0) ? i - 1 : 0; ci <= i && ci + 1 < numU; ci++)
+        {
+            for (std::size_t cj = (j > 0) ? j - 1 : 0; cj <= j && cj + 1 < numV; cj++)
+            {
+                std::size_t corners[4] = { ci * numV + cj, (ci + 1) * numV + cj, (ci + 1) * numV + cj + 1, ci * numV + cj + 1 };
+                for (int t = 0; t < 2; t++)
+                {
+                    double e1[3], e2[3], tn[3];
+                    for (int c = 0; c < 3; c++)
+                    {
+                        e1[c] = gridPoint(corners[t + 1], c) - gridPoint(corners[0], c);
+                        e2[c] = gridPoint(corners[t + 2], c) - gridPoint(corners[0], c);
+                    }
+                    cross(e1, e2, tn);
+                    for (int c = 0; c < 3; c++)
+                        n[c] += tn[c];
+                }
+            }
+        }
+    };
+
+    // Keep the triangles inside the trims and number their vertices
+    std::vector<Json::Int64> remap(gridSize, -1);
+    auto addVertex = [&](std::size_t idx) {
+        if (remap[idx] < 0)
+        {
+            remap[idx] = (Json::Int64)(mesh.vertices.size() / 3);
+            for (int c = 0; c < 3; c++)
+                mesh.vertices.push_back(gridPoint(idx, c));
+
+            double n[3];
+            tangentNormal(idx, n);
+            double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length <= minTangentArea)
+            {
+                fallbackNormal(idx, n);
+                length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            }
+
+            // Surfaces without any area fall back to the z axis
+            double sign = (flip) ? -1.0 : 1.0;
+            for (int c = 0; c < 3; c++)
+                mesh.normals.push_back((length > 0.0) ? sign * n[c] / length : ((c == 2) ? sign : 0.0));
+        }
+        mesh.indices.push_back(remap[idx]);
+    };
+    auto addTriangle = [&](std::size_t a, std::size_t b, std::size_t c) {
+        addVertex(a);
+        if (flip)
+        {
+            addVertex(c);
+            addVertex(b);
+        }
+        else
+        {
+            addVertex(b);
+            addVertex(c);
+        }
+    };
+    for (std::size_t i = 0; i + 1 < numU; i++)
+    {
+        const double u0 = params[0][i], u1 = params[0][i + 1];
+        for (std::size_t j = 0; j + 1 < numV; j++)
+        {
+            const double v0 = params[1][j], v1 = params[1][j + 1];
+            std::size_t a = i * numV + j, b = (i + 1) * numV + j, c = (i + 1) * numV + j + 1, d = i * numV + j + 1;
+            if (insideTrims(trims, (u0 + 2.0 * u1) / 3.0, (2.0 * v0 + v1) / 3.0))
+                addTriangle(a, b, c);
+            if (insideTrims(trims, (2.0 * u0 + u1) / 3.0, (v0 + 2.0 * v1) / 3.0))
+                addTriangle(a, c, d);
+        }
+    }
+}
+
+bool readCachedMesh(const ON_Mesh *cachedMesh, TriangleMesh &mesh)
+{
+    if (cachedMesh == nullptr || cachedMesh->VertexCount() == 0 || cachedMesh->FaceCount() == 0)
+        return false;
+
+    // Prefer the double precision vertices if they are in sync with the single precision ones
+    int vertexCount = cachedMesh->VertexCount();
+    mesh.vertices.resize(3 * vertexCount);
+    if (cachedMesh->HasDoublePrecisionVertices())
+    {
+        for (int i = 0; i < vertexCount; i++)
+        {
+            const ON_3dPoint &pt = cachedMesh->m_dV[i];
+            mesh.vertices[3 * i] = pt.x;
+            mesh.vertices[3 * i + 1] = pt.y;
+            mesh.vertices[3 * i + 2] = pt.z;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < vertexCount; i++)
+        {
+            const ON_3fPoint &pt = cachedMesh->m_V[i];
+            mesh.vertices[3 * i] = pt.x;
+            mesh.vertices[3 * i + 1] = pt.y;
+            mesh.vertices[3 * i + 2] = pt.z;
+        }
+    }
+
+    // Vertex normals are written only if the cache has them
+    mesh.normals.clear();
+    if (cachedMesh->HasVertexNormals())
+    {
+        mesh.normals.resize(3 * vertexCount);
+        for (int i = 0; i < vertexCount; i++)
+        {
+            const ON_3fVector &n = cachedMesh->m_N[i];
+            mesh.normals[3 * i] = n.x;
+            mesh.normals[3 * i + 1] = n.y;
+            mesh.normals[3 * i + 2] = n.z;
+        }
+    }
+
+    // Quads (vi[2] != vi[3]) are split along the diagonal from the first vertex
+    int faceCount = cachedMesh->FaceCount();
+    mesh.indices.clear();
+    mesh.indices.reserve(6 * faceCount);
+    for (int i = 0; i < faceCount; i++)
+    {
+        const int *vi = cachedMesh->m_F[i].vi;
+        mesh.indices.push_back(vi[0]);
+        mesh.indices.push_back(vi[1]);
+        mesh.indices.push_back(vi[2]);
+        if (vi[2] != vi[3])
+        {
+            mesh.indices.push_back(vi[0]);
+            mesh.indices.push_back(vi[2]);
+            mesh.indices.push_back(vi[3]);
+        }
+    }
+    return true;
+}
+
+void writeTriangleMesh(const TriangleMesh &mesh, GeometrySink &sink, const char *key)
+{
+    sink.beginObject(key);
+    sink.writeDoubleArray("vertices", mesh.vertices.data(), mesh.vertices.size());
+    if (!mesh.normals.empty())
+        sink.writeDoubleArray("normals", mesh.normals.data(), mesh.normals.size());
+    sink.writeIntArray("indices", mesh.indices.data(), mesh.indices.size());
+    sink.endObject();
+}
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2018-2019 IDEA Lab, Iowa State University
+Copyright (c) 2018-2020 Onur Rauf Bingol
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef TESSELLATE_H
+#define TESSELLATE_H
+
+#include "common.h"
+#include "geometry_sink.h"
+#include <opennurbs_public.h>
+
+#ifndef RW3DM_TESSELLATION_MAX_SEGMENTS
+#define RW3DM_TESSELLATION_MAX_SEGMENTS 512
+#endif
+
+// Minimum number of grid segments across the smallest trim curve
+#ifndef RW3DM_TESSELLATION_TRIM_SEGMENTS
+#define RW3DM_TESSELLATION_TRIM_SEGMENTS 8
+#endif
+
+// Parameter step of the tangents of the vertex normals relative to the surface domain
+#ifndef RW3DM_TESSELLATION_NORMAL_STEP
+#define RW3DM_TESSELLATION_NORMAL_STEP 1e-6
+#endif
+
+// Triangle mesh of a tessellated surface (vertex coordinates, optional vertex normals and three vertex indices per triangle)
+struct TriangleMesh {
+    std::vector<double> vertices;
+    std::vector<double> normals;
+    std::vector<Json::Int64> indices;
+};
+
+// Trim boundary in the (u, v) domain of a surface as a polyline (u0, v0, u1, v1, ...)
+typedef std::vector<double> TrimPolyline;
+
+// Samples a 2-dimensional trim curve as a polyline
+void sampleTrimCurve(const ON_NurbsCurve &, TrimPolyline &);
+
+/** \brief Tessellates a NURBS surface on a grid aligned with its knots.
+
+The number of grid segments bounds the chord error using the second differences
+of the control points; the tolerance is relative to the extent of the control
+points. If trim polylines are given, the grid is refined to resolve the smallest
+trim curve, and the triangles whose centers are outside of the trimmed region
+(even-odd rule) are dropped. The vertex normals are computed from the
+tangents of the surface (forward differences of the evaluator). The last argument flips the orientation of the triangles and
+the normals.
+*/
+void tessellateSurface(const ON_NurbsSurface &, const std::vector<TrimPolyline> &, double, bool, TriangleMesh &);
+
+// Copies a cached mesh (e.g. a render mesh) to a triangle mesh, splitting the quads; returns false if there is no mesh
+bool readCachedMesh(const ON_Mesh *, TriangleMesh &);
+
+// Writes the vertex, normal and index buffers of a mesh as an object
+void writeTriangleMesh(const TriangleMesh &, GeometrySink &, const char * = nullptr);
+
+#endif /* TESSELLATE_H */